@@ -111,6 +111,16 @@ int main(int argc, char** argv)
         // cv::Ptr<cv::Feature2D> my_detector;
         // registrar.update_f2d_detector(my_detector);
         
+        // // extract & match keypoints on images downscaled to 800px (longer side),
+        // // homography matrix will be rescaled back to full resolution
+        // registrar.update_working_resolution(800);
+        
+        // // only extract keypoints inside 90% of the moon radius guessed from image center
+        // registrar.update_keypoint_mask(0.9f);
+        
+        // // estimate rotation, scale & translation only, cheaper than full homography
+        // registrar.update_motion_model(mr::MotionModel::SIMILARITY);
+        
         
         
         // To run image registration algorithm on moon images:
@@ -136,6 +146,9 @@ int main(int argc, char** argv)
         registrar.get_model_keypoints();
         registrar.get_good_keypoint_matches();
         
+        // mean reprojection error of homography matrix on inlier keypoint matches
+        std::cout << "Reprojection Error: " << registrar.calc_reprojection_error() << "\n";
+        
         // 1.b) use computed intermediate data to generate outer image
         
         // cv::Mat input_image, output_image;
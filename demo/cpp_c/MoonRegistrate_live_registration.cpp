@@ -32,12 +32,27 @@ int main(int argc, char** argv)
     
     cv::Mat model_img = imread(MODEL_IMAGE, cv::IMREAD_UNCHANGED);
     cv::Mat layer_img = imread(LAYER_IMAGE, cv::IMREAD_UNCHANGED);
+    
+#ifdef MR_HAVE_OPENCV_VIDEO
+    // mr::MoonRegistrationTracker only runs a full registration on keyframes,
+    // and tracks keypoints with optical flow in between keyframes
+    mr::MoonRegistrationTracker tracker(model_img, mr::RegistrationAlgorithms::SIFT);
+    
+    // Currently, SURF algorithm works the best, but its disabled by default.
+    // Learn more in BUILDING.md at "About OpenCV versions & modules" section.
+    // tracker.update_f2d_detector(mr::RegistrationAlgorithms::SURF_NONFREE);
+    
+    // keyframe registration on downscaled images is usually good enough for live video
+    tracker.get_registrar().update_working_resolution(800);
+#else
+    // without OpenCV video module, detect & register the moon on every frame
     mr::MoonRegistrar registrar;
     registrar.update_f2d_detector(mr::RegistrationAlgorithms::SIFT);
     
     // Currently, SURF algorithm works the best, but its disabled by default.
     // Learn more in BUILDING.md at "About OpenCV versions & modules" section.
     // registrar.update_f2d_detector(mr::RegistrationAlgorithms::SURF_NONFREE);
+#endif
     
     // ==================== MoonRegistration ====================
     
@@ -82,6 +97,17 @@ int main(int argc, char** argv)
         
         try
         {
+#ifdef MR_HAVE_OPENCV_VIDEO
+            // track moon registration on current frame,
+            // a new keyframe (moon detection + registration) is computed when tracking degrades
+            if (!tracker.track(frame))
+                throw std::runtime_error("Cannot register moon in current frame.");
+            
+            // transform layer image to match the perspective of current frame
+            cv::Mat transformed_layer;
+            tracker.transform_layer_image(layer_img, transformed_layer);
+            cv::Rect roi(0, 0, frame.cols, frame.rows);
+#else
             // detect moon location from current frame
             mr::MoonDetector detector(frame);
             mr::Circle circle = detector.detect_moon();
@@ -100,9 +126,10 @@ int main(int argc, char** argv)
             // transform layer image to match the perspective of user image
             cv::Mat transformed_layer;
             registrar.transform_layer_image(layer_img, transformed_layer);
+            cv::Rect roi = mr::rectangle_to_roi(rect_out);
+#endif
             
             // draw transformed layer image on top of current frame, so we can show it
-            cv::Rect roi = mr::rectangle_to_roi(rect_out);
             float layer_image_transparency = 1.0f;
             const cv::Vec4b filter_px = cv::Vec4b(0,0,0,255);
             mr::stack_imgs_in_place(frame, roi, transformed_layer, layer_image_transparency, &filter_px);
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "MoonRegistration/imgprocess.hpp"
+#include "MoonRegistration/binary_image.hpp"
 #include "MoonRegistration/shapes.hpp"
 #include "MoonRegistration/utils.hpp"
 
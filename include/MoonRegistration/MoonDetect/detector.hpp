@@ -83,7 +83,7 @@ public:
     // taking raw cv::Mat image as input
     // this constructor will assume cv_image is a decoded pixel matrix ready to use
     // it will set cv_image to original_image directly
-    // colors in cv_image MUST in BGR order
+    // colors in cv_image MUST in BGR order, or cv_image is a single channel gray image
     EXPORT_SYMBOL MoonDetector(const cv::Mat& cv_image);
     
     
@@ -95,9 +95,19 @@ public:
     // (re)init mr::MoonDetector by image_binary
     EXPORT_SYMBOL void init_by_byte(const std::vector<unsigned char>& image_binary);
     
-    // (re)init mr::MoonDetector by image_in
+    // (re)init mr::MoonDetector by image_in, image_in is copied
     EXPORT_SYMBOL void init_by_mat(const cv::Mat& image_in);
     
+    // (re)init mr::MoonDetector by a borrowed view of image_in, without copying its pixels
+    // 
+    // Note:
+    //   - the caller MUST keep image_in's buffer alive and unmodified
+    //     until the next init_by_*() or the end of last detect_moon()
+    //   - a cv::Mat wrapping external memory has no reference count,
+    //     so it will NOT keep that memory alive
+    //   - default steps never write to original_image, custom preprocess_steps must not either
+    EXPORT_SYMBOL void init_by_mat_view(const cv::Mat& image_in);
+    
     // update hough circle detection algorithm and default functions
     // this function will overwrite the step function pointer base on the input algorithm
     // If the library is compiled with OpenCV < 4.8.1, we will use HOUGH_GRADIENT algorithm by default
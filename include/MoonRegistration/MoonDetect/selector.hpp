@@ -9,6 +9,7 @@
 #include "MoonRegistration/version.hpp"
 
 #include "MoonRegistration/shapes.hpp"
+#include "MoonRegistration/binary_image.hpp"
 
 
 namespace mr
@@ -25,6 +26,21 @@ EXPORT_SYMBOL std::vector<cv::Vec3f> select_n_circles_by_brightness_perc(
     int n
 );
 
+// same as above, image_in is a packed black & white image,
+// brightness perc of every circle reads 1 bit per pixel
+EXPORT_SYMBOL Circle select_circle_by_brightness_perc(
+    const mr::BinaryImage& image_in,
+    const std::vector<cv::Vec3f>& detected_circles
+);
+
+// same as above, image_in is a packed black & white image,
+// brightness perc of every circle reads 1 bit per pixel
+EXPORT_SYMBOL std::vector<cv::Vec3f> select_n_circles_by_brightness_perc(
+    const mr::BinaryImage& image_in,
+    const std::vector<cv::Vec3f>& detected_circles,
+    int n
+);
+
 EXPORT_SYMBOL Circle select_circle_by_largest_radius(
     const cv::Mat& image_in,
     const std::vector<cv::Vec3f>& detected_circles
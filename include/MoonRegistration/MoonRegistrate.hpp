@@ -11,5 +11,15 @@
 #include "MoonRegistration/version.hpp"
 
 #include "MoonRegistration/MoonRegistrate/filter.hpp"
+#include "MoonRegistration/MoonRegistrate/estimator.hpp"
+#include "MoonRegistration/MoonRegistrate/descriptors.hpp"
+#include "MoonRegistration/MoonRegistrate/fourier_mellin.hpp"
+#include "MoonRegistration/MoonRegistrate/circle_rotation.hpp"
+#include "MoonRegistration/MoonRegistrate/layer_asset.hpp"
 #include "MoonRegistration/MoonRegistrate/default_steps.hpp"
 #include "MoonRegistration/MoonRegistrate/registrar.hpp"
+#include "MoonRegistration/MoonRegistrate/batch.hpp"
+#include "MoonRegistration/MoonRegistrate/registry.hpp"
+#include "MoonRegistration/MoonRegistrate/pipeline.hpp"
+#include "MoonRegistration/MoonRegistrate/video_pipeline.hpp"
+#include "MoonRegistration/MoonRegistrate/tracker.hpp"
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+#include "MoonRegistration/MoonRegistrate/default_steps.hpp"
+#include "MoonRegistration/MoonRegistrate/descriptors.hpp"
+#include "MoonRegistration/MoonRegistrate/registrar.hpp"
+
+
+namespace mr
+{
+
+// Result of a single user image registered by mr::register_batch()
+EXPORT_SYMBOL typedef struct RegistrationResult
+{
+    // whether registration succeed, if false, see error_message
+    bool success = false;
+    std::string error_message;
+    
+    // homography matrix maps user image to model image,
+    // model image is sync with user image size, same as mr::MoonRegistrar.
+    // So it can be pass to mr::MoonRegistrar::update_homography_matrix() directly.
+    cv::Mat homography_matrix;
+    
+    // number of good keypoint matches & number of inliers of homography_matrix
+    int good_match_count = 0;
+    int inlier_count = 0;
+    
+    // mean reprojection error (in pixels of synced model image) of inliers
+    double reprojection_error = 0.0;
+    
+    // output of mr::draw_layer_image(), empty if layer image is not provided
+    cv::Mat layer_image_out;
+    
+} RegistrationResult;
+
+// Pre-computed keypoints & descriptors of a model image, it can be shared
+// by many registrations (and threads) as read-only data.
+EXPORT_SYMBOL typedef struct ModelFeatures
+{
+    // model image, in its original size
+    cv::Mat image;
+    
+    // keypoints in original model image coordinate
+    std::vector<cv::KeyPoint> keypoints;
+    
+    // only one of descriptors & compact_descriptors is filled
+    cv::Mat descriptors;
+    mr::CompactDescriptors compact_descriptors;
+    
+} ModelFeatures;
+
+// Compute mr::ModelFeatures of a model image.
+// 
+// Parameters:
+//   - model_image: model image
+//   - f2d_detector: cv::Feature2D detector, see mr::create_f2d_detector()
+//   - features_out: output mr::ModelFeatures
+//   - compact_model_descriptors: store descriptors as mr::CompactDescriptors. default false
+//   - model_descriptor_pca_components: same as mr::CompactDescriptors::compress(). default -1 (disabled)
+EXPORT_SYMBOL void extract_model_features(
+    const cv::Mat& model_image,
+    cv::Ptr<cv::Feature2D>& f2d_detector,
+    mr::ModelFeatures& features_out,
+    const bool compact_model_descriptors = false,
+    const int model_descriptor_pca_components = -1
+);
+
+// Compute keypoints & descriptors of a user image.
+// 
+// Parameters:
+//   - user_image: user image
+//   - f2d_detector: cv::Feature2D detector, must be the same algorithm as model features
+//   - user_keypoints: output keypoints
+//   - user_descriptors: output descriptors
+EXPORT_SYMBOL void extract_user_features(
+    const cv::Mat& user_image,
+    cv::Ptr<cv::Feature2D>& f2d_detector,
+    std::vector<cv::KeyPoint>& user_keypoints,
+    cv::Mat& user_descriptors
+);
+
+// Register one user image against pre-computed mr::ModelFeatures.
+// This is what every worker of mr::register_batch() runs.
+// 
+// Parameters:
+//   - model: pre-computed model features
+//   - user_image: user image
+//   - user_keypoints: keypoints of user_image, from mr::extract_user_features()
+//   - user_descriptors: descriptors of user_image, from mr::extract_user_features()
+//   - match_batch: reusable mr::MatchBatch buffer
+//   - result: output mr::RegistrationResult
+//   - the rest of parameters are the same as mr::register_batch()
+// 
+// Note:
+//   - throws on failure, result.success is only set when registration succeed
+EXPORT_SYMBOL void register_with_model_features(
+    const mr::ModelFeatures& model,
+    const cv::Mat& user_image,
+    const std::vector<cv::KeyPoint>& user_keypoints,
+    const cv::Mat& user_descriptors,
+    mr::MatchBatch& match_batch,
+    mr::RegistrationResult& result,
+    const cv::Mat& layer_image = cv::Mat(),
+    const float layer_image_transparency = 1.0,
+    const cv::Vec4b* filter_px = NULL,
+    const int knn_k = 2,
+    const float good_match_ratio = 0.7,
+    const int find_homography_method = cv::RANSAC,
+    const double find_homography_ransac_reproj_threshold = 5.0,
+    const std::function<bool(
+        const cv::DMatch&,
+        const cv::DMatch&,
+        const float,
+        const cv::KeyPoint&,
+        const cv::KeyPoint&,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& is_good_match = nullptr,
+    const std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& filter_good_matches = mr::default_filter_good_matches,
+    const std::function<cv::Mat(
+        const std::vector<cv::Point2f>&,
+        const std::vector<cv::Point2f>&,
+        const std::vector<float>&,
+        const mr::EstimatorParams&,
+        std::vector<unsigned char>&
+    )>& estimate_homography = mr::default_estimate_homography,
+    const mr::EstimatorParams& estimator_params = mr::EstimatorParams()
+);
+
+// Register many user images against one model image.
+// Keypoints & descriptors of model image are computed only once, and
+// user images are distributed to a pool of worker threads.
+// Each worker owns its own cv::Feature2D detector.
+// 
+// Parameters:
+//   - model_image: model image
+//   - user_images: list of user images
+//   - algorithm: mr::RegistrationAlgorithms to use
+//   - results: output list of mr::RegistrationResult, one for each user image in the same order
+//   - layer_image: optional layer image, when it is not empty, mr::draw_layer_image() will be
+//     called for every succeed user image and write to mr::RegistrationResult::layer_image_out.
+//     default empty cv::Mat()
+//   - layer_image_transparency: same as mr::draw_layer_image(), default 1.0
+//   - filter_px: same as mr::draw_layer_image(), default NULL
+//   - num_threads: number of worker threads, set it to a value <= 0 to use all hardware threads.
+//     default -1
+//   - knn_k: same as mr::MoonRegistrar::compute_registration(), default 2
+//   - good_match_ratio: same as mr::MoonRegistrar::compute_registration(), default 0.7
+//   - find_homography_method: same as mr::MoonRegistrar::compute_registration(), default RANSAC
+//   - find_homography_ransac_reproj_threshold: same as mr::MoonRegistrar::compute_registration(), default 5.0
+//   - is_good_match: same as mr::MoonRegistrar::is_good_match, when it is set,
+//     it is used instead of filter_good_matches. default empty
+//   - filter_good_matches: same as mr::MoonRegistrar::filter_good_matches,
+//     default mr::default_filter_good_matches.
+//   - is_good_match and filter_good_matches will be called from multiple threads,
+//     so they must be thread-safe.
+//   - compact_model_descriptors: store model descriptors as mr::CompactDescriptors (uint8),
+//     and match user descriptors against the compact form. default false
+//   - model_descriptor_pca_components: same as mr::CompactDescriptors::compress(),
+//     only used when compact_model_descriptors is true. default -1 (disabled)
+//   - estimate_homography: same as mr::MoonRegistrar::estimate_homography,
+//     it will be called from multiple threads. default mr::default_estimate_homography
+//   - estimator_params: motion_model, max_iters & confidence passed to estimate_homography,
+//     same as mr::MoonRegistrar::update_motion_model() & mr::MoonRegistrar::update_estimator_params().
+//     method & ransac_reproj_threshold are replaced by find_homography_method &
+//     find_homography_ransac_reproj_threshold. default mr::EstimatorParams()
+// 
+// Note:
+//   - failure of one user image will not stop other user images,
+//     check mr::RegistrationResult::success of each result.
+EXPORT_SYMBOL void register_batch(
+    const cv::Mat& model_image,
+    const std::vector<cv::Mat>& user_images,
+    const mr::RegistrationAlgorithms& algorithm,
+    std::vector<mr::RegistrationResult>& results,
+    const cv::Mat& layer_image = cv::Mat(),
+    const float layer_image_transparency = 1.0,
+    const cv::Vec4b* filter_px = NULL,
+    const int num_threads = -1,
+    const int knn_k = 2,
+    const float good_match_ratio = 0.7,
+    const int find_homography_method = cv::RANSAC,
+    const double find_homography_ransac_reproj_threshold = 5.0,
+    const std::function<bool(
+        const cv::DMatch&,
+        const cv::DMatch&,
+        const float,
+        const cv::KeyPoint&,
+        const cv::KeyPoint&,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& is_good_match = nullptr,
+    const std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& filter_good_matches = mr::default_filter_good_matches,
+    const bool compact_model_descriptors = false,
+    const int model_descriptor_pca_components = -1,
+    const std::function<cv::Mat(
+        const std::vector<cv::Point2f>&,
+        const std::vector<cv::Point2f>&,
+        const std::vector<float>&,
+        const mr::EstimatorParams&,
+        std::vector<unsigned char>&
+    )>& estimate_homography = mr::default_estimate_homography,
+    const mr::EstimatorParams& estimator_params = mr::EstimatorParams()
+);
+
+}
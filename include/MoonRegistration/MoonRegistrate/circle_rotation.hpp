@@ -0,0 +1,48 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/shapes.hpp"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+
+// feature-free registration with known moon circles
+
+namespace mr
+{
+
+// Register user_image to model_image using moon circles found in both images (e.g. by mr::MoonDetector).
+// 
+// With both circles known, scale & translation are known, leaving only in-plane rotation.
+// Both moon disks are unwrapped into polar images with a canonical radius, every ring is
+// normalized to zero mean, and rotation is the peak of 1D circular cross-correlation
+// along the angle axis, summed over all the rings. It costs O(canonical_radius * angle_steps).
+// 
+// Parameters:
+//   - user_image: user image
+//   - user_circle: moon circle in user_image
+//   - model_image: model image
+//   - model_circle: moon circle in model_image
+//   - homography_out: output 3x3 homography matrix maps user_image coordinate to model_image coordinate
+//   - canonical_radius: number of radius samples of polar images. default 128
+//   - angle_steps: number of angle samples of polar images, angle resolution is 360 / angle_steps degrees.
+//     default 360
+//   - radius_ratio: float ratio (0~1) of circle radius to unwrap, it keeps the limb and background out.
+//     default 0.95
+// 
+// Returns:
+//   - normalized cross-correlation score (-1~1) at the best rotation, higher is better
+EXPORT_SYMBOL double register_by_circles(
+    const cv::Mat& user_image,
+    const mr::Circle& user_circle,
+    const cv::Mat& model_image,
+    const mr::Circle& model_circle,
+    cv::Mat& homography_out,
+    const int canonical_radius = 128,
+    const int angle_steps = 360,
+    const float radius_ratio = 0.95f
+);
+
+}
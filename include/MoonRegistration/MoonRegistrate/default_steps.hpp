@@ -6,6 +6,8 @@
 #include "MoonRegistration/macros.h"
 #include "MoonRegistration/mrconfig.h"
 #include "MoonRegistration/version.hpp"
+#include "MoonRegistration/MoonRegistrate/filter.hpp"
+#include "MoonRegistration/MoonRegistrate/estimator.hpp"
 
 
 // This header defined default detection steps
@@ -41,6 +43,8 @@ EXPORT_SYMBOL bool default_is_good_match_lowes_ratio_only(
 // Filter by ignore_edge_kp first, and then
 // filter by lowes_ratio_test, finally use
 // ignore_close_kp to filter a last time
+// ignore_close_kp keeps its buffer across calls until mr::reset_filter_by_ignore_close_kp(),
+// so all the matches of a registration are checked against each other
 EXPORT_SYMBOL bool default_is_good_match_all(
     const cv::DMatch& m,
     const cv::DMatch& n,
@@ -51,4 +55,43 @@ EXPORT_SYMBOL bool default_is_good_match_all(
     const cv::Mat& model_image
 );
 
+// Batch version of mr::default_is_good_match(),
+// default one for mr::MoonRegistrar class.
+// Filter all the matches by ignore_edge_kp and lowes_ratio_test
+EXPORT_SYMBOL void default_filter_good_matches(
+    mr::MatchBatch& batch,
+    const float good_match_ratio,
+    const cv::Mat& user_image,
+    const cv::Mat& model_image
+);
+
+// Batch version of mr::default_is_good_match_lowes_ratio_only(),
+// filter all the matches by lowes_ratio_test only
+EXPORT_SYMBOL void default_filter_good_matches_lowes_ratio_only(
+    mr::MatchBatch& batch,
+    const float good_match_ratio,
+    const cv::Mat& user_image,
+    const cv::Mat& model_image
+);
+
+// Batch version of mr::default_is_good_match_all(),
+// filter all the matches by ignore_edge_kp and lowes_ratio_test,
+// finally use ignore_close_kp to filter a last time
+EXPORT_SYMBOL void default_filter_good_matches_all(
+    mr::MatchBatch& batch,
+    const float good_match_ratio,
+    const cv::Mat& user_image,
+    const cv::Mat& model_image
+);
+
+// default homography estimator for mr::MoonRegistrar class
+// Estimate homography with mr::estimate_homography(), match_distances is ignored
+EXPORT_SYMBOL cv::Mat default_estimate_homography(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const std::vector<float>& match_distances,
+    const mr::EstimatorParams& params,
+    std::vector<unsigned char>& inlier_mask
+);
+
 }
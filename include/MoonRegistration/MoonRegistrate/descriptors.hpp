@@ -0,0 +1,119 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/mat.hpp>
+
+#include <vector>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+
+// compact descriptor storage
+
+namespace mr
+{
+
+// Compact storage of keypoints descriptors that are kept in memory for a long time,
+// e.g. model descriptors shared by many registrations.
+// 
+// Float descriptors (SIFT, AKAZE with float output, etc.) are optionally reduced by PCA,
+// and then quantized to uint8 with one global scale & offset. A single scale keeps
+// euclidean distances proportional to the original ones, so Lowe's ratio test is not affected.
+// SIFT descriptors shrink from 512 bytes to 128 bytes (or pca_components bytes) per keypoint.
+// Binary descriptors (ORB, BRISK) are already compact, they are stored as is.
+// 
+// Query descriptors are encoded with the same PCA & scale before matching,
+// and match distances are converted back to the original descriptor space.
+EXPORT_SYMBOL typedef class CompactDescriptors
+{
+public:
+    // constructors
+    EXPORT_SYMBOL CompactDescriptors();
+    EXPORT_SYMBOL CompactDescriptors(const cv::Mat& descriptors, const int pca_components = -1);
+    
+    // Compress descriptors, replace previous content.
+    // 
+    // Parameters:
+    //   - descriptors: one descriptor per row, CV_32F or CV_8U (binary descriptors)
+    //   - pca_components: number of PCA components to keep for float descriptors,
+    //     set it to a value <= 0 or >= descriptors.cols to disable PCA. default -1 (disabled)
+    EXPORT_SYMBOL void compress(const cv::Mat& descriptors, const int pca_components = -1);
+    
+    // Encode descriptors with the same PCA & quantization of stored descriptors.
+    // 
+    // Parameters:
+    //   - descriptors: one descriptor per row, same type & width as the compressed descriptors
+    //   - compact_out: output encoded descriptors
+    EXPORT_SYMBOL void encode(const cv::Mat& descriptors, cv::Mat& compact_out) const;
+    
+    // Same as cv::BFMatcher::knnMatch(), match query descriptors against stored descriptors.
+    // Match distances are in the original descriptor space.
+    // 
+    // Parameters:
+    //   - query_descriptors: one descriptor per row, not encoded
+    //   - matches: output knn matches, trainIdx is row of stored descriptors
+    //   - knn_k: number of nearest neighbors
+    EXPORT_SYMBOL void knn_match(
+        const cv::Mat& query_descriptors,
+        std::vector<std::vector<cv::DMatch>>& matches,
+        const int knn_k
+    ) const;
+    
+    
+    // getters
+    
+    // encoded descriptors, one per row
+    EXPORT_SYMBOL const cv::Mat& get_data() const
+    {
+        return this->data;
+    }
+    
+    // number of stored descriptors
+    EXPORT_SYMBOL int rows() const
+    {
+        return this->data.rows;
+    }
+    
+    EXPORT_SYMBOL bool empty() const
+    {
+        return this->data.empty();
+    }
+    
+    // norm type used for matching, cv::NORM_L2 or cv::NORM_HAMMING
+    EXPORT_SYMBOL int get_norm_type() const
+    {
+        return this->norm_type;
+    }
+    
+    // number of PCA components, -1 if PCA is disabled
+    EXPORT_SYMBOL int get_pca_components() const
+    {
+        return this->pca_components;
+    }
+    
+    // memory used by encoded descriptors & PCA basis in bytes
+    EXPORT_SYMBOL size_t size_in_bytes() const;
+    
+    // memory used by the original descriptors in bytes
+    EXPORT_SYMBOL size_t original_size_in_bytes() const
+    {
+        return this->original_bytes;
+    }
+    
+private:
+    cv::Mat data;
+    cv::PCA pca;
+    int pca_components = -1;
+    int norm_type = cv::NORM_L2;
+    int descriptor_type = -1;
+    int descriptor_cols = 0;
+    // quantized = original * scale + offset
+    double scale = 1.0;
+    double offset = 0.0;
+    size_t original_bytes = 0;
+    
+} CompactDescriptors;
+
+}
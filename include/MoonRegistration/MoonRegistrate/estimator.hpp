@@ -0,0 +1,127 @@
+#pragma once
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include <vector>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+
+// robust homography estimator functions
+
+namespace mr
+{
+
+// Motion models between user image and model image.
+// The moon is a sphere viewed from effectively infinite distance,
+// so its motion is dominated by rotation, scale and translation.
+// Lower degrees of freedom need fewer inliers and fewer robust method iterations.
+EXPORT_SYMBOL typedef enum class MotionModel
+{
+    // rotation, uniform scale & translation (4 DoF), cv::estimateAffinePartial2D()
+    SIMILARITY                         = 0x100,
+    // affine transformation (6 DoF), cv::estimateAffine2D()
+    AFFINE                             = 0x101,
+    // full perspective transformation (8 DoF), cv::findHomography()
+    HOMOGRAPHY                         = 0x102,
+} MotionModel;
+
+// minimum number of point pairs required to estimate a motion model
+EXPORT_SYMBOL int min_points_of_motion_model(const mr::MotionModel& motion_model);
+
+EXPORT_SYMBOL typedef struct EstimatorParams
+{
+    // motion model to estimate, the result is always a 3x3 homography matrix
+    mr::MotionModel motion_model = mr::MotionModel::HOMOGRAPHY;
+    // method for cv::findHomography(), 0, RANSAC, LMEDS, RHO, or USAC_* when available
+    int method = cv::RANSAC;
+    // maximum allowed reprojection error (in pixels) to treat a point pair as an inlier
+    double ransac_reproj_threshold = 5.0;
+    // maximum number of robust method iterations
+    int max_iters = 2000;
+    // confidence level (0~1). Robust methods adapt their number of iterations
+    // to the inlier ratio found so far, and stop early once this confidence is reached.
+    // so lower confidence => fewer iterations on good image pairs
+    double confidence = 0.995;
+} EstimatorParams;
+
+// Estimate homography with cv::findHomography() using the method in params.
+// RANSAC, RHO and USAC_* methods stop early once params.confidence is reached.
+// When params.motion_model is SIMILARITY or AFFINE, cv::estimateAffinePartial2D() or
+// cv::estimateAffine2D() is used instead, with RANSAC unless params.method is LMEDS,
+// and the 2x3 result is expanded to a 3x3 homography matrix.
+// 
+// Parameters:
+//   - user_pts: user keypoints
+//   - model_pts: model keypoints
+//   - params: mr::EstimatorParams
+//   - inlier_mask: output inlier mask, 1 for inliers, same order as input points
+// 
+// Returns:
+//   - homography matrix maps user_pts to model_pts, empty if failed
+EXPORT_SYMBOL cv::Mat estimate_homography(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const mr::EstimatorParams& params,
+    std::vector<unsigned char>& inlier_mask
+);
+
+// Estimate homography with PROSAC.
+// PROSAC samples from the best matches first, so it usually finds a good
+// hypothesis in a few iterations when best matches are mostly inliers.
+// Points are sorted by match_distances (lower is better) before estimation.
+// Uses cv::USAC_PROSAC when available, otherwise uses cv::RHO (also PROSAC-based).
+// params.method is ignored.
+// For SIMILARITY & AFFINE motion models, sorted points are passed to mr::estimate_homography().
+// 
+// Parameters:
+//   - user_pts: user keypoints
+//   - model_pts: model keypoints
+//   - match_distances: descriptor distances of each point pair
+//   - params: mr::EstimatorParams
+//   - inlier_mask: output inlier mask, 1 for inliers, same order as input points
+// 
+// Returns:
+//   - homography matrix maps user_pts to model_pts, empty if failed
+EXPORT_SYMBOL cv::Mat estimate_homography_prosac(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const std::vector<float>& match_distances,
+    const mr::EstimatorParams& params,
+    std::vector<unsigned char>& inlier_mask
+);
+
+#ifdef MR_HAVE_OPENCV_USAC
+
+// Estimate homography with OpenCV USAC framework configured by cv::UsacParams:
+// PROSAC sampling by match_distances, MAGSAC++ scoring and local optimization.
+// params.method is ignored.
+// For SIMILARITY & AFFINE motion models, sorted points are passed to mr::estimate_homography().
+// 
+// Parameters:
+//   - user_pts: user keypoints
+//   - model_pts: model keypoints
+//   - match_distances: descriptor distances of each point pair
+//   - params: mr::EstimatorParams
+//   - inlier_mask: output inlier mask, 1 for inliers, same order as input points
+// 
+// Returns:
+//   - homography matrix maps user_pts to model_pts, empty if failed
+EXPORT_SYMBOL cv::Mat estimate_homography_usac(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const std::vector<float>& match_distances,
+    const mr::EstimatorParams& params,
+    std::vector<unsigned char>& inlier_mask
+);
+
+#endif
+
+// count number of inliers in inlier mask
+EXPORT_SYMBOL int count_inliers(const std::vector<unsigned char>& inlier_mask);
+
+}
@@ -3,6 +3,9 @@
 #include <opencv2/core/types.hpp>
 #include <opencv2/core/mat.hpp>
 
+#include <vector>
+#include <functional>
+
 #include "MoonRegistration/macros.h"
 #include "MoonRegistration/mrconfig.h"
 #include "MoonRegistration/version.hpp"
@@ -13,6 +16,52 @@
 namespace mr
 {
 
+// Structure-of-arrays buffer of knn matches, used by batch filter functions.
+// Element i of every array describes the same match, so batch filters can
+// run over flat arrays without touching cv::DMatch or cv::KeyPoint.
+// Buffers are reused between calls to mr::MatchBatch::assign(),
+// so a long-lived MatchBatch doesn't allocate after the first registration.
+EXPORT_SYMBOL typedef struct MatchBatch
+{
+    // matches[i][0]
+    std::vector<float> m_distance;
+    std::vector<int> query_idx;
+    std::vector<int> train_idx;
+    // matches[i][1].distance, FLT_MAX if there is no second match
+    std::vector<float> n_distance;
+    // user_keypoints[query_idx[i]].pt & model_keypoints[train_idx[i]].pt
+    std::vector<cv::Point2f> user_pts;
+    std::vector<cv::Point2f> model_pts;
+    // 1 if match i is still a good match, 0 if it is filtered out
+    std::vector<unsigned char> mask;
+    
+    // (re)fill all the arrays from cv::BFMatcher::knnMatch() output, all the matches start as good matches
+    EXPORT_SYMBOL void assign(
+        const std::vector<std::vector<cv::DMatch>>& matches,
+        const std::vector<cv::KeyPoint>& user_keypoints,
+        const std::vector<cv::KeyPoint>& model_keypoints
+    );
+    
+    // number of matches
+    EXPORT_SYMBOL size_t size() const;
+    
+    // number of good matches
+    EXPORT_SYMBOL size_t count() const;
+    
+    // copy good matches out as cv::DMatch, user points & model points
+    // 
+    // Parameters:
+    //   - good_matches: output good matches
+    //   - user_pts: output user points of good matches
+    //   - model_pts: output model points of good matches
+    EXPORT_SYMBOL void collect(
+        std::vector<cv::DMatch>& good_matches,
+        std::vector<cv::Point2f>& user_pts,
+        std::vector<cv::Point2f>& model_pts
+    ) const;
+    
+} MatchBatch;
+
 // Filter keypoints descriptor by Lowe's Ratio Test
 // 
 // Lower the ratio => larger the differences between keypoints descriptor => more keypoints get filter out
@@ -61,10 +110,18 @@ EXPORT_SYMBOL bool filter_by_ignore_edge_kp(
 //   - user_image: user image
 //   - model_image: model image
 //   - hash_coordinate_ratio: float ratio (0~1) to determine how much we want to "blur" keypoints coordinates
-//   - is_first_time: bool flag to determine whether we need to cleanup buffer hash map
+//   - is_first_time: bool flag to determine whether we need to cleanup buffer hash map,
+//     pass false to keep the buffer of current registration
 // 
 // Returns:
 //   - true or false to tell whether we need to filter current keypoints
+// 
+// Note:
+//   - buffer hash map lives across calls and it is thread local,
+//     so different threads can filter their own keypoints at the same time.
+//     prefer the mr::MatchBatch version, it keeps its buffer inside the call.
+//   - buffer hash map is also cleaned up after mr::reset_filter_by_ignore_close_kp(),
+//     mr::MoonRegistrar calls it before filtering matches of each registration
 EXPORT_SYMBOL bool filter_by_ignore_close_kp(
     const cv::KeyPoint& user_kpt,
     const cv::KeyPoint& model_kpt,
@@ -74,4 +131,100 @@ EXPORT_SYMBOL bool filter_by_ignore_close_kp(
     const bool is_first_time = true
 );
 
+// Make next mr::filter_by_ignore_close_kp() call cleanup buffer hash map of current thread,
+// call it before filtering the matches of a new registration
+EXPORT_SYMBOL void reset_filter_by_ignore_close_kp();
+
+
+// Batch version of mr::filter_by_lowes_ratio_test(),
+// filter all the good matches in a mr::MatchBatch at once
+// 
+// Parameters:
+//   - batch: mr::MatchBatch to filter, its mask will be updated
+//   - ratio: float ratio between 0~1
+EXPORT_SYMBOL void filter_by_lowes_ratio_test(
+    mr::MatchBatch& batch,
+    const float ratio = 0.7
+);
+
+// Batch version of mr::filter_by_ignore_edge_kp(),
+// filter all the good matches in a mr::MatchBatch at once
+// 
+// Parameters:
+//   - batch: mr::MatchBatch to filter, its mask will be updated
+//   - user_size: user image size
+//   - model_size: model image size
+//   - radius_guess_ratio: float ratio (0~1) to determine how much of edge to ignore
+EXPORT_SYMBOL void filter_by_ignore_edge_kp(
+    mr::MatchBatch& batch,
+    const cv::Size& user_size,
+    const cv::Size& model_size,
+    const float radius_guess_ratio = 0.9
+);
+
+// Batch version of mr::filter_by_ignore_close_kp(),
+// filter all the good matches in a mr::MatchBatch at once
+// 
+// Parameters:
+//   - batch: mr::MatchBatch to filter, its mask will be updated
+//   - user_size: user image size
+//   - model_size: model image size
+//   - hash_coordinate_ratio: float ratio (0~1) to determine how much we want to "blur" keypoints coordinates
+// 
+// Note:
+//   - matches are visited in order, and only the ones that are still good matches
+//     are considered, so filter with this function last.
+EXPORT_SYMBOL void filter_by_ignore_close_kp(
+    mr::MatchBatch& batch,
+    const cv::Size& user_size,
+    const cv::Size& model_size,
+    const float hash_coordinate_ratio = 0.3
+);
+
+
+// Filter knn matches of one registration down to good matches,
+// shared by mr::MoonRegistrar::compute_registration() & mr::register_with_model_features()
+// 
+// Parameters:
+//   - matches: cv::BFMatcher::knnMatch() output
+//   - user_keypoints: user keypoints, queryIdx of matches
+//   - model_keypoints: model keypoints, trainIdx of matches
+//   - user_image: user image passed into filter functions
+//   - model_image: model image passed into filter functions
+//   - good_match_ratio: n m distance ratio passed into filter functions
+//   - is_good_match: same as mr::MoonRegistrar::is_good_match, used when it is not empty
+//   - filter_good_matches: same as mr::MoonRegistrar::filter_good_matches,
+//     used when is_good_match is empty
+//   - match_batch: reusable mr::MatchBatch buffer
+//   - good_matches: output good matches
+//   - user_pts: output user points of good matches
+//   - model_pts: output model points of good matches
+EXPORT_SYMBOL void select_good_matches(
+    const std::vector<std::vector<cv::DMatch>>& matches,
+    const std::vector<cv::KeyPoint>& user_keypoints,
+    const std::vector<cv::KeyPoint>& model_keypoints,
+    const cv::Mat& user_image,
+    const cv::Mat& model_image,
+    const float good_match_ratio,
+    const std::function<bool(
+        const cv::DMatch&,
+        const cv::DMatch&,
+        const float,
+        const cv::KeyPoint&,
+        const cv::KeyPoint&,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& is_good_match,
+    const std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& filter_good_matches,
+    mr::MatchBatch& match_batch,
+    std::vector<cv::DMatch>& good_matches,
+    std::vector<cv::Point2f>& user_pts,
+    std::vector<cv::Point2f>& model_pts
+);
+
 }
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+
+// feature-free registration with Fourier-Mellin phase correlation
+
+namespace mr
+{
+
+// Register user_image to model_image with log-polar Fourier-Mellin phase correlation.
+// 
+// Both images are placed on a fixed size canvas, rotation & scale are found by phase correlation
+// of log-polar magnitude spectrums, and then translation is found by phase correlation
+// of the rotated & scaled user canvas with model canvas. It doesn't rely on image texture,
+// and its cost only depends on canvas_size.
+// 
+// Parameters:
+//   - user_image: user image, a well-centered moon crop works best (e.g. mr::cut_image_from_circle())
+//   - model_image: model image
+//   - homography_out: output 3x3 homography matrix maps user_image coordinate to model_image coordinate
+//   - canvas_size: size of the square canvas (rounded down to an even number >= 32). default 256
+// 
+// Returns:
+//   - phase correlation response (0~1) of translation step, higher is better
+// 
+// Note:
+//   - only rotation, uniform scale & translation are recovered
+//   - accuracy is limited by canvas_size, one canvas pixel is about
+//     (longer side of image / canvas_size) image pixels
+EXPORT_SYMBOL double register_fourier_mellin(
+    const cv::Mat& user_image,
+    const cv::Mat& model_image,
+    cv::Mat& homography_out,
+    const int canvas_size = 256
+);
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/mat.hpp>
+
+#include <vector>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+
+// preprocessed layer image
+
+namespace mr
+{
+
+// A layer image preprocessed once and drawn many times.
+// 
+// mr::draw_layer_image() with a cv::Mat layer image derives alpha channel of layer image
+// and resamples the full resolution layer image in every call. mr::LayerAsset does that
+// work only once when it is built:
+//   - layer image is converted to premultiplied BGRA, 3 channels & 1 channel layer images
+//     get an alpha channel the same way as mr::draw_layer_image() (opaque when gray value > 0)
+//   - a mip pyramid is built with cv::pyrDown(), so a large layer image drawn on a small
+//     user image is sampled from a level close to the output size, which is faster and alias-free
+// 
+// Pass it to mr::transform_layer_image(), mr::draw_layer_image(),
+// or mr::MoonRegistrar::draw_layer_image() instead of a cv::Mat layer image.
+EXPORT_SYMBOL typedef class LayerAsset
+{
+public:
+    // constructors
+    EXPORT_SYMBOL LayerAsset();
+    
+    // build from layer_image, see update_layer_image()
+    EXPORT_SYMBOL explicit LayerAsset(const cv::Mat& layer_image, const int max_levels = -1);
+    
+    // Build premultiplied BGRA & mip pyramid from layer_image, replace previous content.
+    // 
+    // Parameters:
+    //   - layer_image: 1, 3, or 4 channels CV_8U layer image
+    //   - max_levels: maximum number of pyramid levels including the full resolution one,
+    //     set it to a value <= 0 to build levels until the shorter side is too small. default -1
+    EXPORT_SYMBOL void update_layer_image(const cv::Mat& layer_image, const int max_levels = -1);
+    
+    // Select the pyramid level to sample from.
+    // 
+    // Parameters:
+    //   - footprint: number of full resolution layer pixels covered by one output pixel
+    //     along each side, e.g. 4.0 when layer image is drawn at 1/4 of its size
+    // 
+    // Returns:
+    //   - the smallest level that is still at least as large as the output
+    EXPORT_SYMBOL int select_level(const double footprint) const;
+    
+    // Matrix maps a full resolution layer pixel to a pixel in level
+    EXPORT_SYMBOL cv::Matx33d get_level_transform(const int level) const;
+    
+    
+    // getters
+    
+    EXPORT_SYMBOL bool empty() const
+    {
+        return this->levels.empty();
+    }
+    
+    // size of full resolution layer image
+    EXPORT_SYMBOL cv::Size size() const
+    {
+        return this->levels.empty() ? cv::Size() : this->levels[0].size();
+    }
+    
+    // number of pyramid levels, level 0 is the full resolution one
+    EXPORT_SYMBOL int level_count() const
+    {
+        return static_cast<int>(this->levels.size());
+    }
+    
+    // premultiplied BGRA CV_8UC4 image of a pyramid level
+    EXPORT_SYMBOL const cv::Mat& get_level(const int level) const;
+    
+private:
+    std::vector<cv::Mat> levels;
+    
+} LayerAsset;
+
+}
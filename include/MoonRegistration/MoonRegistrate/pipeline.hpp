@@ -0,0 +1,220 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+#include "MoonRegistration/shapes.hpp"
+
+#include "MoonRegistration/MoonDetect/detector.hpp"
+#include "MoonRegistration/MoonRegistrate/registrar.hpp"
+#include "MoonRegistration/MoonRegistrate/batch.hpp"
+
+
+namespace mr
+{
+
+// Detect the moon, crop it, and register it against a model image in one call.
+// 
+// All the stages share intermediate products of the input image:
+//   - the image is decoded once, cv::Mat input is shared without a copy
+//   - the image is converted to gray once, mr::MoonDetector and keypoint extraction both use it
+//   - the moon crop is a ROI view of the image (mr::cut_ref_image_from_circle()),
+//     its gray version is a ROI view of the gray image
+//   - model keypoints & descriptors are extracted once in update_model_image()
+// 
+// Note:
+//   - homography_matrix of result maps the moon crop to model image synced with crop size,
+//     same as mr::MoonRegistrar, so it works with mr::transform_layer_image() & mr::draw_layer_image()
+//     on get_user_crop()
+//   - the crop is a view of the input image, modify the input image will modify the crop
+EXPORT_SYMBOL typedef class MoonRegistrationPipeline
+{
+public:
+    // constructors
+    
+    EXPORT_SYMBOL MoonRegistrationPipeline();
+    
+    EXPORT_SYMBOL MoonRegistrationPipeline(
+        const cv::Mat& model_image,
+        const mr::RegistrationAlgorithms& algorithm,
+        const cv::Mat& layer_image = cv::Mat()
+    );
+    
+    
+    // setters
+    
+    // (re)init model_image & optional layer_image, model features are extracted right away
+    EXPORT_SYMBOL void update_model_image(const cv::Mat& model_image, const cv::Mat& layer_image = cv::Mat());
+    
+    // (re)init f2d_detector with pre-defined algorithms, model features are extracted again.
+    // Feature-free algorithms are not supported.
+    EXPORT_SYMBOL void update_f2d_detector(const mr::RegistrationAlgorithms& algorithm);
+    
+    // update padding pixels of moon crop, same as mr::cut_ref_image_from_circle(). default 15
+    EXPORT_SYMBOL void update_crop_padding(const int crop_padding);
+    
+    // (re)init input image by image_filepath, it is decoded once for all the stages
+    EXPORT_SYMBOL void update_image(const std::string& image_filepath);
+    
+    // (re)init input image by image_binary, it is decoded once for all the stages
+    EXPORT_SYMBOL void update_image(const std::vector<unsigned char>& image_binary);
+    
+    // (re)init input image by image_in, colors MUST in BGR order.
+    // image_in is shared, not copied.
+    EXPORT_SYMBOL void update_image(const cv::Mat& image_in);
+    
+    
+    // getters
+    
+    EXPORT_SYMBOL const cv::Mat& get_image() const
+    {
+        return this->image;
+    }
+    
+    EXPORT_SYMBOL const cv::Mat& get_gray_image() const
+    {
+        return this->gray_image;
+    }
+    
+    EXPORT_SYMBOL const mr::Circle& get_circle() const
+    {
+        return this->circle;
+    }
+    
+    // rectangle of moon crop in input image
+    EXPORT_SYMBOL const mr::Rectangle& get_crop_rect() const
+    {
+        return this->crop_rect;
+    }
+    
+    // moon crop, a ROI view of input image
+    EXPORT_SYMBOL const cv::Mat& get_user_crop() const
+    {
+        return this->user_crop;
+    }
+    
+    // gray moon crop, a ROI view of gray image
+    EXPORT_SYMBOL const cv::Mat& get_gray_crop() const
+    {
+        return this->gray_crop;
+    }
+    
+    EXPORT_SYMBOL const mr::RegistrationResult& get_result() const
+    {
+        return this->result;
+    }
+    
+    EXPORT_SYMBOL const mr::ModelFeatures& get_model_features() const
+    {
+        return this->model;
+    }
+    
+    // internal mr::MoonDetector, you can use it to customize detection steps
+    EXPORT_SYMBOL mr::MoonDetector& get_detector()
+    {
+        return this->detector;
+    }
+    
+    
+    // pipeline
+    
+    // Run detection, cropping and registration on input image.
+    // 
+    // Parameters:
+    //   - knn_k: same as mr::MoonRegistrar::compute_registration(), default 2
+    //   - good_match_ratio: same as mr::MoonRegistrar::compute_registration(), default 0.7
+    //   - find_homography_method: same as mr::MoonRegistrar::compute_registration(), default RANSAC
+    //   - find_homography_ransac_reproj_threshold: same as mr::MoonRegistrar::compute_registration(), default 5.0
+    // 
+    // Returns:
+    //   - true if the moon is found and registered, see get_result()
+    //   - false otherwise, see get_result().error_message
+    EXPORT_SYMBOL bool run(
+        const int knn_k = 2,
+        const float good_match_ratio = 0.7,
+        const int find_homography_method = cv::RANSAC,
+        const double find_homography_ransac_reproj_threshold = 5.0
+    );
+    
+    // Transform layer image and draws it on top of moon crop, then write to image_out.
+    // Same as mr::draw_layer_image() with get_user_crop() & homography_matrix of last run().
+    // 
+    // Parameters:
+    //   - image_out: output image, it has the same size as moon crop
+    //   - layer_image_transparency: same as mr::draw_layer_image(), default 1.0
+    //   - filter_px: same as mr::draw_layer_image(), default NULL
+    EXPORT_SYMBOL void draw_layer_image(
+        cv::Mat& image_out,
+        const float layer_image_transparency = 1.0,
+        const cv::Vec4b* filter_px = NULL
+    );
+    
+    
+    // public members
+    
+    // same as mr::MoonRegistrar::is_good_match
+    std::function<bool(
+        const cv::DMatch&,
+        const cv::DMatch&,
+        const float,
+        const cv::KeyPoint&,
+        const cv::KeyPoint&,
+        const cv::Mat&,
+        const cv::Mat&
+    )> is_good_match = nullptr;
+    
+    // same as mr::MoonRegistrar::filter_good_matches
+    std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )> filter_good_matches = mr::default_filter_good_matches;
+    
+    // same as mr::MoonRegistrar::estimate_homography
+    std::function<cv::Mat(
+        const std::vector<cv::Point2f>&,
+        const std::vector<cv::Point2f>&,
+        const std::vector<float>&,
+        const mr::EstimatorParams&,
+        std::vector<unsigned char>&
+    )> estimate_homography = mr::default_estimate_homography;
+    
+    // motion_model, max_iters & confidence passed to estimate_homography,
+    // method & ransac_reproj_threshold are replaced by run() parameters
+    mr::EstimatorParams estimator_params;
+    
+private:
+    // stages
+    mr::MoonDetector detector;
+    cv::Ptr<cv::Feature2D> f2d_detector;
+    mr::RegistrationAlgorithms algorithm = mr::RegistrationAlgorithms::INVALID_ALGORITHM;
+    mr::MatchBatch match_batch;
+    int crop_padding = 15;
+    
+    // model
+    mr::ModelFeatures model;
+    cv::Mat layer_image;
+    
+    // intermediate products of current image
+    cv::Mat image;
+    cv::Mat gray_image;
+    mr::Circle circle = {-1, -1, -1};
+    mr::Rectangle crop_rect = {0, 0, 0, 0};
+    cv::Mat user_crop;
+    cv::Mat gray_crop;
+    std::vector<cv::KeyPoint> user_keypoints;
+    cv::Mat user_descriptors;
+    mr::RegistrationResult result;
+    
+} MoonRegistrationPipeline;
+
+}
@@ -7,11 +7,16 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <cstdint>
 
 #include "MoonRegistration/macros.h"
 #include "MoonRegistration/mrconfig.h"
 #include "MoonRegistration/version.hpp"
+#include "MoonRegistration/shapes.hpp"
 #include "MoonRegistration/MoonRegistrate/default_steps.hpp"
+#include "MoonRegistration/MoonRegistrate/fourier_mellin.hpp"
+#include "MoonRegistration/MoonRegistrate/circle_rotation.hpp"
+#include "MoonRegistration/MoonRegistrate/layer_asset.hpp"
 
 
 namespace mr
@@ -29,12 +34,205 @@ EXPORT_SYMBOL typedef enum class RegistrationAlgorithms
     SURF_NONFREE                       = 0x200,
 #endif
     
+    // feature-free algorithms, they don't use cv::Feature2D,
+    // so there is no keypoints or good matches after registration
+    FOURIER_MELLIN                     = 0x300,
+    
     EMPTY_ALGORITHM                    = 0x001,
     INVALID_ALGORITHM                  = 0x000
 } RegistrationAlgorithms;
 
+// Create a cv::Feature2D for algorithm.
+// f2d_detector is left empty for EMPTY_ALGORITHM and feature-free algorithms.
 EXPORT_SYMBOL void create_f2d_detector(const mr::RegistrationAlgorithms algorithm, cv::Ptr<cv::Feature2D>& f2d_detector);
 
+// One tier of registration cascade used by mr::MoonRegistrar::compute_registration_cascade().
+// A tier is accepted when its registration succeed and meets all of its quality thresholds.
+EXPORT_SYMBOL typedef struct RegistrationTier
+{
+    // algorithm of this tier
+    mr::RegistrationAlgorithms algorithm = mr::RegistrationAlgorithms::SIFT;
+    
+    // working_resolution of this tier, <= 0 means full resolution
+    int working_resolution = -1;
+    
+    // minimum ratio (0~1) of homography inliers over good matches
+    float min_inlier_ratio = 0.0f;
+    
+    // maximum mean reprojection error in pixels of model_image downscaled to working_resolution,
+    // it is scaled to full resolution before comparing, set it to a value <= 0 to disable it
+    double max_reprojection_error = -1.0;
+    
+    // minimum phase correlation response (0~1), only for feature-free algorithms
+    double min_phase_correlation_response = 0.0;
+} RegistrationTier;
+
+// Default registration cascade: ORB at 512px working resolution first,
+// then SIFT at full resolution without any threshold.
+EXPORT_SYMBOL std::vector<mr::RegistrationTier> default_registration_cascade();
+
+// Transform a layer image to the perspective of user image using a homography_matrix
+// computed by mr::MoonRegistrar. This is what mr::MoonRegistrar::transform_layer_image() runs,
+// it only needs the size of user image.
+// 
+// Parameters:
+//   - user_image_size: size of user image
+//   - homography_matrix: homography matrix maps user image to model image
+//   - layer_image_in: input image
+//   - layer_image_out: output image
+// 
+// Note:
+//   - input layer image's size will be sync with user_image_size
+EXPORT_SYMBOL void transform_layer_image(
+    const cv::Size& user_image_size,
+    const cv::Mat& homography_matrix,
+    const cv::Mat& layer_image_in,
+    cv::Mat& layer_image_out
+);
+
+// Transform a layer image using mr::transform_layer_image(), and draws it on top of
+// user_image, then write to image_out. This is what mr::MoonRegistrar::draw_layer_image() runs.
+// 
+// Warp and blend are fused into one pass parallel over rows: every output pixel is mapped
+// back through homography_matrix into the layer image, sampled with bilinear
+// interpolation, and blended right away, no intermediate warped layer image is created.
+// A layer image larger than user_image is resized with cv::INTER_AREA first,
+// same as mr::transform_layer_image(), so it doesn't alias.
+// 
+// Parameters:
+//   - user_image: user image
+//   - homography_matrix: homography matrix maps user image to model image
+//   - layer_image_in: input layer image
+//   - image_out: output image
+//   - layer_image_transparency: a 0~1 float percentage changing layer image's transparency,
+//     default 1.0
+//   - filter_px: pointer to cv::Vec4b pixel with pixel value to filter in the foreground image.
+//     A pixel will be ignore when all of its values is <= filter_px.
+//     Set it to NULL if you don't need it, default NULL.
+EXPORT_SYMBOL void draw_layer_image(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const cv::Mat& layer_image_in,
+    cv::Mat& image_out,
+    const float layer_image_transparency = 1.0,
+    const cv::Vec4b* filter_px = NULL
+);
+
+// Same as mr::transform_layer_image() above, but transform a preprocessed mr::LayerAsset.
+// The pyramid level matching output size is warped, instead of the full resolution layer image.
+// 
+// Parameters:
+//   - user_image_size: size of user image
+//   - homography_matrix: homography matrix maps user image to model image
+//   - layer_asset: preprocessed layer image
+//   - layer_image_out: output premultiplied BGRA image, same size as layer image synced with user_image_size
+EXPORT_SYMBOL void transform_layer_image(
+    const cv::Size& user_image_size,
+    const cv::Mat& homography_matrix,
+    const mr::LayerAsset& layer_asset,
+    cv::Mat& layer_image_out
+);
+
+// Same as mr::draw_layer_image() above, but draw a preprocessed mr::LayerAsset.
+// No alpha channel is derived per call, and the pyramid level matching output size is sampled.
+// 
+// Parameters:
+//   - user_image: user image, 1, 3, or 4 channels CV_8U image
+//   - homography_matrix: homography matrix maps user image to model image
+//   - layer_asset: preprocessed layer image
+//   - image_out: output BGRA image
+//   - layer_image_transparency: same as above, default 1.0
+//   - filter_px: same as above, compared with un-premultiplied BGRA pixel of layer_asset. default NULL
+// 
+// Note:
+//   - layer image is blended with its alpha, so semi-transparent pixels are blended
+//     instead of being drawn as opaque pixels
+EXPORT_SYMBOL void draw_layer_image(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const mr::LayerAsset& layer_asset,
+    cv::Mat& image_out,
+    const float layer_image_transparency = 1.0,
+    const cv::Vec4b* filter_px = NULL
+);
+
+// Fused version of mr::MoonRegistrar::draw_stacked_red_green_image() for checking registration results.
+// Every output pixel samples user_image through the inverse homography and model_image
+// resized to user_image size, converts both to gray, and writes B/G/R in a single pass,
+// without intermediate warped, gray, or zero images.
+// 
+// Parameters:
+//   - user_image: user image, 1, 3, or 4 channels CV_8U image
+//   - model_image: model image, 1, 3, or 4 channels CV_8U image
+//   - homography_matrix: homography matrix maps user image to model image
+//   - image_out: output CV_8UC3 image, transformed user image in red channel and
+//     model image in green channel. its buffer is reused if it already has output size & type
+//   - preview_resolution: when > 0, image_out is downscaled so its longer side fits in it.
+//     default -1 (full user_image size)
+EXPORT_SYMBOL void draw_stacked_red_green_image(
+    const cv::Mat& user_image,
+    const cv::Mat& model_image,
+    const cv::Mat& homography_matrix,
+    cv::Mat& image_out,
+    const int preview_resolution = -1
+);
+
+// A layer drawn by mr::draw_layer_images()
+EXPORT_SYMBOL typedef struct LayerDrawItem
+{
+    // 3 or 4 channels CV_8U layer image, ignored when layer_asset is set
+    cv::Mat layer_image;
+    
+    // preprocessed layer image used instead of layer_image, not owned by LayerDrawItem.
+    // default NULL
+    const mr::LayerAsset* layer_asset = NULL;
+    
+    // a 0~1 float percentage changing layer image's transparency, default 1.0
+    float layer_image_transparency = 1.0f;
+    
+    // pixel value to filter in layer image, same as filter_px of mr::draw_layer_image().
+    // only used when use_filter_px is true, default false
+    bool use_filter_px = false;
+    cv::Vec4b filter_px = cv::Vec4b(0,0,0,255);
+    
+} LayerDrawItem;
+
+// Draw several layers on top of user_image in order, then write to image_out.
+// Same result as calling mr::draw_layer_image() once per layer, but the warp of every layer
+// is set up once and all the layers are sampled & blended in a single pass over image_out,
+// user_image is not copied between layers.
+// 
+// Parameters:
+//   - user_image: user image, 1, 3, or 4 channels CV_8U image
+//   - homography_matrix: homography matrix maps user image to model image, shared by all the layers
+//   - layers: layers to draw, later layers are drawn on top of earlier layers
+//   - image_out: output BGRA image
+EXPORT_SYMBOL void draw_layer_images(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const std::vector<mr::LayerDrawItem>& layers,
+    cv::Mat& image_out
+);
+
+// Reference version of mr::draw_layer_image(), it runs mr::transform_layer_image() and
+// mr::stack_imgs() step by step. mr::draw_layer_image() falls back to it when
+// user_image or layer_image_in is not a 3 or 4 channels CV_8U image.
+// 
+// Parameters:
+//   - same as mr::draw_layer_image()
+// 
+// Note:
+//   - layer image is resized before warping here, and sampled directly in mr::draw_layer_image(),
+//     so two outputs can differ slightly around edges of layer image
+EXPORT_SYMBOL void draw_layer_image_reference(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const cv::Mat& layer_image_in,
+    cv::Mat& image_out,
+    const float layer_image_transparency = 1.0,
+    const cv::Vec4b* filter_px = NULL
+);
+
 EXPORT_SYMBOL typedef class MoonRegistrar
 {
 public:
@@ -75,9 +273,20 @@ public:
         const std::vector<unsigned char>& model_image_binary
     );
     
-    // (re)init user_image & model_image with cv::Mat
+    // (re)init user_image & model_image with cv::Mat, both images are copied
     EXPORT_SYMBOL void update_images(const cv::Mat& user_image, const cv::Mat& model_image);
     
+    // (re)init user_image & model_image with borrowed views of cv::Mat, without copying their pixels.
+    // model_image is only copied when it has to be resized to sync with user_image.
+    // 
+    // Note:
+    //   - the caller MUST keep both buffers alive and unmodified until the next update_images*()
+    //     or until it finishes using this mr::MoonRegistrar
+    //   - a cv::Mat wrapping external memory has no reference count,
+    //     so it will NOT keep that memory alive
+    //   - mr::MoonRegistrar never writes to user_image & model_image
+    EXPORT_SYMBOL void update_images_view(const cv::Mat& user_image, const cv::Mat& model_image);
+    
     
     // (re)init f2d_detector with pre-defined algorithms
     EXPORT_SYMBOL void update_f2d_detector(const mr::RegistrationAlgorithms& algorithm);
@@ -88,9 +297,91 @@ public:
     // update homography_matrix
     EXPORT_SYMBOL void update_homography_matrix(const cv::Mat& homography_matrix);
     
-    // update good_keypoint_matches
+    // update good_keypoint_matches, only first element of each match is used
     EXPORT_SYMBOL void update_good_keypoint_matches(const std::vector<std::vector<cv::DMatch>>& good_keypoint_matches);
     
+    // update working_resolution
+    // 
+    // When working_resolution > 0 and user_image's longer side is larger than it,
+    // mr::MoonRegistrar::compute_registration() will downscale user_image & model_image
+    // so their longer side fits in working_resolution before extracting & matching keypoints.
+    // Computed homography_matrix & keypoints are rescaled back to full resolution,
+    // so all the transform_* and draw_* functions work the same way.
+    // is_good_match & filter_good_matches receive the downscaled color images,
+    // so they stay in the same coordinate as keypoints.
+    // Set it to a value <= 0 to disable it. default -1 (disabled)
+    EXPORT_SYMBOL void update_working_resolution(const int working_resolution);
+    
+    // update motion model estimated by mr::MoonRegistrar::compute_registration()
+    // 
+    // homography_matrix is always a 3x3 matrix, SIMILARITY & AFFINE models are
+    // expanded to 3x3, so all the transform_* and draw_* functions work the same way.
+    // SIMILARITY & AFFINE models need fewer keypoints and are warped with cv::warpAffine().
+    // default HOMOGRAPHY
+    EXPORT_SYMBOL void update_motion_model(const mr::MotionModel& motion_model);
+    
+    // update parameters of homography estimator
+    // 
+    // Parameters:
+    //   - max_iters: maximum number of robust method iterations. default 2000
+    //   - confidence: confidence level (0~1), robust methods stop early once it is reached.
+    //     default 0.995
+    EXPORT_SYMBOL void update_estimator_params(
+        const int max_iters = 2000,
+        const double confidence = 0.995
+    );
+    
+    // update keypoint mask with image center guess
+    // 
+    // When keypoint_mask_ratio > 0, mr::MoonRegistrar::compute_registration() only
+    // extracts keypoints inside a disk mask, so background and edge keypoints never
+    // cost descriptor or matching time. Same as mr::filter_by_ignore_edge_kp(),
+    // we guess the moon is at the center of image with radius (image.width / 2).
+    // 
+    // Parameters:
+    //   - keypoint_mask_ratio: float ratio (0~1) of radius to keep,
+    //     set it to a value <= 0 to disable it. default -1 (disabled)
+    EXPORT_SYMBOL void update_keypoint_mask(const float keypoint_mask_ratio);
+    
+    // update keypoint mask with known moon circles
+    // 
+    // Same as above, but use input circles instead of image center guess.
+    // 
+    // Parameters:
+    //   - user_circle: moon circle in user_image
+    //   - model_circle: moon circle in model_image, after it is synced with user_image size
+    //   - keypoint_mask_ratio: float ratio (0~1) of circle radius to keep. default 0.9
+    EXPORT_SYMBOL void update_keypoint_mask(
+        const mr::Circle& user_circle,
+        const mr::Circle& model_circle,
+        const float keypoint_mask_ratio = 0.9
+    );
+    
+    // update tiers used by mr::MoonRegistrar::compute_registration_cascade(),
+    // from the cheapest to the most expensive. default mr::default_registration_cascade()
+    EXPORT_SYMBOL void update_registration_cascade(const std::vector<mr::RegistrationTier>& registration_cascade);
+    
+    // update warp cache of transformed layer image, and clear the cache
+    // 
+    // When warp_cache_epsilon >= 0, mr::MoonRegistrar::transform_layer_image()
+    // keeps the last transformed layer image, and reuses it
+    // while the same layer image is passed in and the new homography_matrix moves every corner
+    // of user_image by at most warp_cache_epsilon pixels compared with the cached one.
+    // This saves a resize & warp per frame in live overlay, where homography barely changes.
+    // Set it to a value < 0 to disable it. default -1 (disabled)
+    // 
+    // Note:
+    //   - layer images are identified by their buffer, call clear_warp_cache()
+    //     after modifying a layer image in place
+    //   - on a cache hit, layer_image_out of transform_layer_image() shares buffer with the cache,
+    //     clone it before modifying it in place
+    //   - the cache only applies to transform_layer_image(),
+    //     draw_layer_image() and other draw_* functions always warp the layer image
+    EXPORT_SYMBOL void update_warp_cache_epsilon(const double warp_cache_epsilon);
+    
+    // drop the cached transformed layer image, hit & miss counters are kept
+    EXPORT_SYMBOL void clear_warp_cache();
+    
     
     // getters
     
@@ -119,11 +410,101 @@ public:
         return this->model_keypoints;
     }
     
+    EXPORT_SYMBOL const std::vector<cv::DMatch>& get_good_matches() const
+    {
+        return this->good_matches;
+    }
+    
+    // good matches in cv::BFMatcher::knnMatch() layout, one element per match
     EXPORT_SYMBOL const std::vector<std::vector<cv::DMatch>>& get_good_keypoint_matches() const
     {
         return this->good_keypoint_matches;
     }
     
+    EXPORT_SYMBOL int get_working_resolution() const
+    {
+        return this->working_resolution;
+    }
+    
+    // algorithm set by update_f2d_detector(), EMPTY_ALGORITHM for custom cv::Feature2D
+    EXPORT_SYMBOL const mr::RegistrationAlgorithms& get_algorithm() const
+    {
+        return this->algorithm;
+    }
+    
+    // phase correlation response (0~1) of last registration with FOURIER_MELLIN algorithm
+    EXPORT_SYMBOL double get_phase_correlation_response() const
+    {
+        return this->phase_correlation_response;
+    }
+    
+    // normalized cross-correlation score (-1~1) of last compute_registration_by_circles()
+    EXPORT_SYMBOL double get_angular_correlation_score() const
+    {
+        return this->angular_correlation_score;
+    }
+    
+    EXPORT_SYMBOL const std::vector<mr::RegistrationTier>& get_registration_cascade() const
+    {
+        return this->registration_cascade;
+    }
+    
+    // index of registration_cascade tier accepted by last compute_registration_cascade(),
+    // -1 when no tier is accepted
+    EXPORT_SYMBOL int get_cascade_tier() const
+    {
+        return this->cascade_tier;
+    }
+    
+    EXPORT_SYMBOL double get_warp_cache_epsilon() const
+    {
+        return this->warp_cache_epsilon;
+    }
+    
+    // number of transformed layer images reused from / added to warp cache
+    EXPORT_SYMBOL uint64_t get_warp_cache_hits() const
+    {
+        return this->warp_cache_hits;
+    }
+    
+    EXPORT_SYMBOL uint64_t get_warp_cache_misses() const
+    {
+        return this->warp_cache_misses;
+    }
+    
+    EXPORT_SYMBOL const mr::MotionModel& get_motion_model() const
+    {
+        return this->motion_model;
+    }
+    
+    // motion_model, max_iters & confidence used by mr::MoonRegistrar::compute_registration(),
+    // method & ransac_reproj_threshold are left as default
+    EXPORT_SYMBOL mr::EstimatorParams get_estimator_params() const
+    {
+        mr::EstimatorParams params;
+        params.motion_model = this->motion_model;
+        params.max_iters = this->estimator_max_iters;
+        params.confidence = this->estimator_confidence;
+        return params;
+    }
+    
+    EXPORT_SYMBOL float get_keypoint_mask_ratio() const
+    {
+        return this->keypoint_mask_ratio;
+    }
+    
+    // inlier mask of good_matches from last homography estimation, 1 for inliers
+    EXPORT_SYMBOL const std::vector<unsigned char>& get_homography_inlier_mask() const
+    {
+        return this->homography_inlier_mask;
+    }
+    
+    // number of inliers from last homography estimation
+    EXPORT_SYMBOL int get_inlier_count() const
+    {
+        return this->inlier_count;
+    }
+    
     
     // registration
     
@@ -139,9 +520,18 @@ public:
     //       - RANSAC - RANSAC-based robust method
     //       - LMEDS - Least-Median robust method
     //       - RHO - PROSAC-based robust method
+    //       - USAC_* - USAC framework methods, when OpenCV >= 4.5.1
     //     default to RANSAC
     //   - find_homography_ransac_reproj_threshold: double, RansacReprojThreshold for cv::findHomograph().
     //     default 5.0
+    // 
+    // Note:
+    //   - with FOURIER_MELLIN algorithm, homography_matrix is computed by mr::register_fourier_mellin(),
+    //     all the parameters are ignored, and there is no keypoints or good matches.
+    //   - when working_resolution is enabled, find_homography_ransac_reproj_threshold
+    //     is measured in pixels of the downscaled images
+    //   - homography_matrix is estimated by mr::MoonRegistrar::estimate_homography,
+    //     find_homography_method may be ignored by custom estimators
     EXPORT_SYMBOL void compute_registration(
         const int knn_k = 2,
         const float good_match_ratio = 0.7,
@@ -149,6 +539,53 @@ public:
         const double find_homography_ransac_reproj_threshold = 5.0
     );
     
+    // Run mr::MoonRegistrar::compute_registration() with every tier of registration_cascade in order,
+    // and stop at the first tier meets its quality thresholds. Cheap tiers handle most of
+    // the images, and expensive tiers only run when cheap tiers fail.
+    // 
+    // Parameters:
+    //   - same as mr::MoonRegistrar::compute_registration()
+    // 
+    // Returns:
+    //   - index of accepted tier, also available from get_cascade_tier().
+    //     -1 when no tier meets its thresholds, registration result of the last successful tier is kept then.
+    // 
+    // Note:
+    //   - throws when no tier can find homography_matrix
+    //   - a failed tier doesn't touch keypoints, good matches & homography_matrix of the last successful tier
+    //   - f2d_detector & working_resolution are restored after the cascade, even when it throws
+    EXPORT_SYMBOL int compute_registration_cascade(
+        const int knn_k = 2,
+        const float good_match_ratio = 0.7,
+        const int find_homography_method = cv::RANSAC,
+        const double find_homography_ransac_reproj_threshold = 5.0
+    );
+    
+    // Compute homography_matrix from moon circles of user_image and model_image,
+    // using mr::register_by_circles(). Scale & translation come from the circles,
+    // and only rotation is solved, it doesn't use f2d_detector.
+    // Keypoints and good matches are cleared.
+    // 
+    // Parameters:
+    //   - user_circle: moon circle in user_image
+    //   - model_circle: moon circle in model_image, after it is synced with user_image size
+    //   - canonical_radius: same as mr::register_by_circles(), default 128
+    //   - angle_steps: same as mr::register_by_circles(), default 360
+    EXPORT_SYMBOL void compute_registration_by_circles(
+        const mr::Circle& user_circle,
+        const mr::Circle& model_circle,
+        const int canonical_radius = 128,
+        const int angle_steps = 360
+    );
+    
+    // Compute mean reprojection error (in pixels of model_image) of homography_matrix,
+    // using the inliers of good_keypoint_matches from last mr::MoonRegistrar::compute_registration().
+    // If there is no inlier information, all good_keypoint_matches are used.
+    // 
+    // Returns:
+    //   - double mean euclidean distance between projected user keypoints and model keypoints
+    EXPORT_SYMBOL double calc_reprojection_error();
+    
     // Using computed homography_matrix to apply a perspective transformation to image_in.
     // "Rotate" image_in using homography_matrix.
     // 
@@ -185,6 +622,10 @@ public:
     //   - input layer image's size will be sync with user_image
     EXPORT_SYMBOL void transform_layer_image(const cv::Mat& layer_image_in, cv::Mat& layer_image_out);
     
+    // Same as above, but transform a preprocessed mr::LayerAsset with mr::transform_layer_image().
+    // Output is premultiplied BGRA, warp cache is not used.
+    EXPORT_SYMBOL void transform_layer_image(const mr::LayerAsset& layer_asset, cv::Mat& layer_image_out);
+    
     
     // draw result image
     
@@ -206,12 +647,27 @@ public:
     //     default is an empty cv::Mat()
     EXPORT_SYMBOL void draw_red_transformed_user_image(cv::Mat& image_out, const cv::Mat& transformed_image_in = cv::Mat());
     
+    // Same as above, but write into a caller preallocated image_out.
+    // Internal buffers are reused between calls, so a frame loop drawing into the same
+    // image_out does not allocate new images.
+    // 
+    // Parameters:
+    //   - image_out: preallocated CV_8UC3 output image with user_image's size
+    //   - transformed_image_in: same as above
+    EXPORT_SYMBOL void draw_red_transformed_user_image_into(cv::Mat& image_out, const cv::Mat& transformed_image_in = cv::Mat());
+    
     // Draw model_image, and output to image_out's green channel
     // 
     // Parameters:
     //   - image_out: output image
     EXPORT_SYMBOL void draw_green_model_image(cv::Mat& image_out);
     
+    // Same as above, but write into a caller preallocated image_out.
+    // 
+    // Parameters:
+    //   - image_out: preallocated CV_8UC3 output image with model_image's size
+    EXPORT_SYMBOL void draw_green_model_image_into(cv::Mat& image_out);
+    
     // Stack red image and green image generated by
     // mr::draw_red_transformed_user_image() and mr::draw_green_model_image()
     // and write to image_out as its red and green channel
@@ -224,6 +680,22 @@ public:
     //     default is an empty cv::Mat()
     EXPORT_SYMBOL void draw_stacked_red_green_image(cv::Mat& image_out, const cv::Mat& transformed_image_in = cv::Mat());
     
+    // Same as above, but write into a caller preallocated image_out.
+    // 
+    // Parameters:
+    //   - image_out: preallocated CV_8UC3 output image with user_image's size
+    //   - transformed_image_in: same as above
+    EXPORT_SYMBOL void draw_stacked_red_green_image_into(cv::Mat& image_out, const cv::Mat& transformed_image_in = cv::Mat());
+    
+    // Same as draw_stacked_red_green_image(), but render with fused mr::draw_stacked_red_green_image()
+    // in a single pass, optionally at a reduced preview resolution
+    // 
+    // Parameters:
+    //   - image_out: output image
+    //   - preview_resolution: when > 0, image_out is downscaled so its longer side fits in it.
+    //     default -1 (full user_image size)
+    EXPORT_SYMBOL void draw_stacked_red_green_image_fused(cv::Mat& image_out, const int preview_resolution = -1);
+    
     // Transform input layer image to the perspective of user_image
     // using mr::transform_layer_image(), and draws it on top of
     // user_image, then write to image_out.
@@ -249,15 +721,126 @@ public:
         const cv::Vec4b* filter_px = NULL
     );
     
+    // Same as above, but draw a preprocessed mr::LayerAsset with mr::draw_layer_image().
+    // Warp cache is not used.
+    EXPORT_SYMBOL void draw_layer_image(
+        const mr::LayerAsset& layer_asset,
+        cv::Mat& image_out,
+        const float layer_image_transparency = 1.0,
+        const cv::Vec4b* filter_px = NULL
+    );
+    
+    // Same as draw_layer_image() above, but write into a caller preallocated image_out.
+    // Layer image is drawn directly into image_out without an intermediate warped image.
+    // 
+    // Parameters:
+    //   - layer_image_in: input layer image, only 3 or 4 channels CV_8U layer image is supported
+    //   - image_out: preallocated CV_8UC4 output image with user_image's size,
+    //     it must not share buffer with user_image
+    //   - layer_image_transparency: same as above, default 1.0
+    //   - filter_px: same as above, default NULL
+    // 
+    // Note:
+    //   - only CV_8U user_image is supported, 1 channel user_image is converted into a scratch buffer
+    //   - throws for other layer image types, use draw_layer_image() for them
+    EXPORT_SYMBOL void draw_layer_image_into(
+        const cv::Mat& layer_image_in,
+        cv::Mat& image_out,
+        const float layer_image_transparency = 1.0,
+        const cv::Vec4b* filter_px = NULL
+    );
+    
+    // Same as above, but draw a preprocessed mr::LayerAsset
+    EXPORT_SYMBOL void draw_layer_image_into(
+        const mr::LayerAsset& layer_asset,
+        cv::Mat& image_out,
+        const float layer_image_transparency = 1.0,
+        const cv::Vec4b* filter_px = NULL
+    );
+    
+    // Draw several layers on top of user_image in a single pass using mr::draw_layer_images().
+    // Warp cache is not used.
+    // 
+    // Parameters:
+    //   - layers: layers to draw, later layers are drawn on top of earlier layers
+    //   - image_out: output image
+    EXPORT_SYMBOL void draw_layer_images(const std::vector<mr::LayerDrawItem>& layers, cv::Mat& image_out);
+    
 public:
     // Following public members of mr::MoonRegistrar are function pointers
     // They are functions handling different steps in mr::MoonRegistrar::compute_registration()
     // You can modify them to further customize how mr::MoonRegistrar::compute_registration() works
     // All the function pointers are default to default_... functions defined in "registrar.hpp"
     
+    // A function pointer to a batch filter function that marks good matches.
+    // It runs once over all the matches returned by cv::BFMatcher::knnMatch(),
+    // stored as flat arrays in a mr::MatchBatch.
+    // It is used only when is_good_match is empty.
+    // 
+    // function signature:
+    //   void (
+    //       mr::MatchBatch& batch,
+    //       const float good_match_ratio,
+    //       const cv::Mat& user_image,
+    //       const cv::Mat& model_image
+    //   )
+    // 
+    // function parameters:
+    //   - batch: all the matches, set batch.mask[i] to 0 to filter out match i
+    //   - good_match_ratio: the same good_match_ratio pass into mr::MoonRegistrar::compute_registration(),
+    //     a float of n m distance ratio for filtering good matches. default 0.7
+    //   - user_image: a const reference to user_image, in the same coordinate as keypoints.
+    //     When working_resolution is set and smaller than user_image, it is user_image
+    //     downscaled to working_resolution, with the same color channels
+    //   - model_image: a const reference to model_image, downscaled the same way as user_image
+    // 
+    // function pointer default points to mr::default_filter_good_matches()
+    std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )> filter_good_matches = mr::default_filter_good_matches;
+    
+    // A function pointer to a robust estimator function that estimates homography_matrix
+    // from good matches. Output inlier mask is kept in mr::MoonRegistrar.
+    // 
+    // function signature:
+    //   cv::Mat (
+    //       const std::vector<cv::Point2f>& user_pts,
+    //       const std::vector<cv::Point2f>& model_pts,
+    //       const std::vector<float>& match_distances,
+    //       const mr::EstimatorParams& params,
+    //       std::vector<unsigned char>& inlier_mask
+    //   )
+    // 
+    // function parameters:
+    //   - user_pts: user keypoints of good matches
+    //   - model_pts: model keypoints of good matches
+    //   - match_distances: descriptor distance of each good match, lower is better
+    //   - params: find_homography_method & find_homography_ransac_reproj_threshold pass into
+    //     mr::MoonRegistrar::compute_registration(), and parameters from update_estimator_params()
+    //   - inlier_mask: output inlier mask, 1 for inliers, same order as user_pts
+    // 
+    // function returns:
+    //   - homography matrix maps user_pts to model_pts, empty if failed
+    // 
+    // Other than mr::default_estimate_homography(), you can also use
+    // mr::estimate_homography_prosac() or mr::estimate_homography_usac() (when available)
+    // 
+    // function pointer default points to mr::default_estimate_homography()
+    std::function<cv::Mat(
+        const std::vector<cv::Point2f>&,
+        const std::vector<cv::Point2f>&,
+        const std::vector<float>&,
+        const mr::EstimatorParams&,
+        std::vector<unsigned char>&
+    )> estimate_homography = mr::default_estimate_homography;
+    
     // A function pointer to a ratio test function that determines
     // whether a pair of keypoints are good matches. It runs in a loop
     // of all the elements in matches returned by cv::BFMatcher::knnMatch()
+    // When it is set, it is used instead of filter_good_matches.
     // 
     // function signature:
     //   bool (
@@ -277,10 +860,13 @@ public:
     //     a float of n m distance ratio for filtering good matches. default 0.7
     //   - user_kpt: user_keypoints[m.queryIdx]
     //   - model_kpt: user_keypoints[m.trainIdx]
-    //   - user_image: a const reference to user_image
-    //   - model_image: a const reference to model_image
+    //   - user_image: a const reference to user_image, in the same coordinate as keypoints.
+    //     When working_resolution is set and smaller than user_image, it is user_image
+    //     downscaled to working_resolution, with the same color channels
+    //   - model_image: a const reference to model_image, downscaled the same way as user_image
     // 
-    // function pointer default points to mr::default_is_good_match()
+    // function pointer default is empty, mr::default_is_good_match() is
+    // the single match version of mr::default_filter_good_matches()
     std::function<bool(
         const cv::DMatch&,
         const cv::DMatch&,
@@ -289,17 +875,59 @@ public:
         const cv::KeyPoint&,
         const cv::Mat&,
         const cv::Mat&
-    )> is_good_match = mr::default_is_good_match;
+    )> is_good_match = nullptr;
     
 private: // helper functions
     void __validate_registrar();
     void __validate_image_matrix();
+    void __clear_keypoints();
+    void __sync_good_keypoint_matches();
+    void __init_images(const cv::Mat& user_image, const cv::Mat& model_image, const bool borrow);
+    const cv::Mat& __transform_layer_image_cached(const cv::Mat& layer_image_in);
+    void __validate_output_buffer(const cv::Mat& image_out, const cv::Size& size, const int type);
+    void __create_keypoint_mask(
+        const cv::Size& image_size,
+        const mr::Circle& circle,
+        const double scale,
+        cv::Mat& mask_out
+    );
     
 private:
     cv::Ptr<cv::Feature2D> f2d_detector;
+    mr::RegistrationAlgorithms algorithm = mr::RegistrationAlgorithms::EMPTY_ALGORITHM;
+    double phase_correlation_response = 0.0;
+    double angular_correlation_score = 0.0;
+    std::vector<mr::RegistrationTier> registration_cascade = mr::default_registration_cascade();
+    int cascade_tier = -1;
     cv::Mat homography_matrix;
+    std::vector<cv::DMatch> good_matches;
+    // good_matches in cv::BFMatcher::knnMatch() layout, kept in sync with good_matches
     std::vector<std::vector<cv::DMatch>> good_keypoint_matches;
+    mr::MatchBatch match_batch;
+    std::vector<unsigned char> homography_inlier_mask;
+    int inlier_count = 0;
+    mr::MotionModel motion_model = mr::MotionModel::HOMOGRAPHY;
+    int estimator_max_iters = 2000;
+    double estimator_confidence = 0.995;
     cv::Size image_size;
+    int working_resolution = -1;
+    // warp cache
+    double warp_cache_epsilon = -1.0;
+    cv::Mat warp_cache_layer_in;
+    cv::Mat warp_cache_layer_out;
+    cv::Mat warp_cache_homography;
+    cv::Size warp_cache_image_size;
+    uint64_t warp_cache_hits = 0;
+    uint64_t warp_cache_misses = 0;
+    // scratch buffers reused by draw_* functions
+    cv::Mat scratch_transformed;
+    cv::Mat scratch_user_bgr;
+    cv::Mat scratch_gray;
+    cv::Mat scratch_model_gray;
+    cv::Mat scratch_green;
+    float keypoint_mask_ratio = -1.0f;
+    mr::Circle user_mask_circle = {-1, -1, -1};
+    mr::Circle model_mask_circle = {-1, -1, -1};
     // user
     cv::Mat user_image;
     std::vector<cv::KeyPoint> user_keypoints;
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+#include "MoonRegistration/MoonRegistrate/registrar.hpp"
+#include "MoonRegistration/MoonRegistrate/batch.hpp"
+
+
+// multiple model images with fast reference selection
+
+namespace mr
+{
+
+// Compute a cheap global signature of a moon image, used to rank model images
+// before doing full keypoints matching.
+// 
+// Image is unwrapped around its center into a small polar image, the signature contains:
+//   - radial brightness profile, it describes the lit part of the moon (phase)
+//   - magnitude of low frequencies of angular brightness profile, it is rotation invariant
+//   - brightness histogram
+// Every part is normalized, so signature is not affected by image size or exposure scaling.
+// 
+// Parameters:
+//   - image: input image, a well-centered moon crop works best (e.g. mr::cut_image_from_circle())
+//   - signature_out: output 1 x N CV_32F signature
+EXPORT_SYMBOL void compute_global_signature(const cv::Mat& image, cv::Mat& signature_out);
+
+// Holds pre-computed features of many model images (and their layer images),
+// and registers a user image against the best matching models.
+// 
+// For every user image, all the models are ranked by distance of global signature
+// (mr::compute_global_signature()), and only the top-k models are fully matched.
+// The model with most homography inliers wins.
+EXPORT_SYMBOL typedef class ModelRegistry
+{
+public:
+    // constructors
+    EXPORT_SYMBOL ModelRegistry(
+        const mr::RegistrationAlgorithms& algorithm = mr::RegistrationAlgorithms::SIFT,
+        const bool compact_model_descriptors = false,
+        const int model_descriptor_pca_components = -1
+    );
+    
+    // Add a model image, its features and global signature are computed right away.
+    // 
+    // Parameters:
+    //   - model_image: model image
+    //   - layer_image: optional layer image of this model, default empty cv::Mat()
+    //   - name: optional name of this model, default ""
+    // 
+    // Returns:
+    //   - index of added model
+    EXPORT_SYMBOL int add_model(
+        const cv::Mat& model_image,
+        const cv::Mat& layer_image = cv::Mat(),
+        const std::string& name = ""
+    );
+    
+    // remove all the models
+    EXPORT_SYMBOL void clear();
+    
+    // Rank models by global signature distance to user_image.
+    // 
+    // Parameters:
+    //   - user_image: user image
+    //   - top_k: max number of model indices to output, set it to a value <= 0 to output all
+    //   - model_indices: output model indices, from the closest to the farthest
+    EXPORT_SYMBOL void select_models(
+        const cv::Mat& user_image,
+        const int top_k,
+        std::vector<int>& model_indices
+    ) const;
+    
+    // Register user_image against top_k models selected by mr::ModelRegistry::select_models().
+    // 
+    // Parameters:
+    //   - user_image: user image
+    //   - result: output mr::RegistrationResult of the best model,
+    //     layer_image_out is filled when the best model has a layer image
+    //   - top_k: number of models to fully match. default 3
+    //   - layer_image_transparency: same as mr::draw_layer_image(), default 1.0
+    //   - filter_px: same as mr::draw_layer_image(), default NULL
+    //   - knn_k: same as mr::MoonRegistrar::compute_registration(), default 2
+    //   - good_match_ratio: same as mr::MoonRegistrar::compute_registration(), default 0.7
+    //   - find_homography_method: same as mr::MoonRegistrar::compute_registration(), default RANSAC
+    //   - find_homography_ransac_reproj_threshold: same as mr::MoonRegistrar::compute_registration(), default 5.0
+    // 
+    // Returns:
+    //   - index of the best model, -1 if no model can be registered (see result.error_message)
+    EXPORT_SYMBOL int register_image(
+        const cv::Mat& user_image,
+        mr::RegistrationResult& result,
+        const int top_k = 3,
+        const float layer_image_transparency = 1.0,
+        const cv::Vec4b* filter_px = NULL,
+        const int knn_k = 2,
+        const float good_match_ratio = 0.7,
+        const int find_homography_method = cv::RANSAC,
+        const double find_homography_ransac_reproj_threshold = 5.0
+    );
+    
+    
+    // getters
+    
+    EXPORT_SYMBOL int size() const
+    {
+        return static_cast<int>(this->models.size());
+    }
+    
+    EXPORT_SYMBOL const mr::ModelFeatures& get_model_features(const int index) const
+    {
+        return this->models.at(index);
+    }
+    
+    EXPORT_SYMBOL const cv::Mat& get_layer_image(const int index) const
+    {
+        return this->layer_images.at(index);
+    }
+    
+    EXPORT_SYMBOL const std::string& get_name(const int index) const
+    {
+        return this->names.at(index);
+    }
+    
+    EXPORT_SYMBOL const mr::RegistrationAlgorithms& get_algorithm() const
+    {
+        return this->algorithm;
+    }
+    
+    
+    // public members
+    
+    // same as mr::MoonRegistrar::is_good_match
+    std::function<bool(
+        const cv::DMatch&,
+        const cv::DMatch&,
+        const float,
+        const cv::KeyPoint&,
+        const cv::KeyPoint&,
+        const cv::Mat&,
+        const cv::Mat&
+    )> is_good_match = nullptr;
+    
+    // same as mr::MoonRegistrar::filter_good_matches
+    std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )> filter_good_matches = mr::default_filter_good_matches;
+    
+    // same as mr::MoonRegistrar::estimate_homography
+    std::function<cv::Mat(
+        const std::vector<cv::Point2f>&,
+        const std::vector<cv::Point2f>&,
+        const std::vector<float>&,
+        const mr::EstimatorParams&,
+        std::vector<unsigned char>&
+    )> estimate_homography = mr::default_estimate_homography;
+    
+    // motion_model, max_iters & confidence passed to estimate_homography,
+    // method & ransac_reproj_threshold are replaced by register_image() parameters
+    mr::EstimatorParams estimator_params;
+    
+private:
+    mr::RegistrationAlgorithms algorithm;
+    cv::Ptr<cv::Feature2D> f2d_detector;
+    bool compact_model_descriptors;
+    int model_descriptor_pca_components;
+    mr::MatchBatch match_batch;
+    
+    // one element per model
+    std::vector<mr::ModelFeatures> models;
+    std::vector<cv::Mat> layer_images;
+    std::vector<std::string> names;
+    std::vector<cv::Mat> signatures;
+    
+} ModelRegistry;
+
+}
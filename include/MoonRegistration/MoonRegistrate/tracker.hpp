@@ -0,0 +1,165 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+
+#include <vector>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+#include "MoonRegistration/MoonRegistrate/registrar.hpp"
+
+// mr::MoonRegistrationTracker requires OpenCV video module for cv::calcOpticalFlowPyrLK()
+#ifdef MR_HAVE_OPENCV_VIDEO
+
+
+namespace mr
+{
+
+// Track moon registration across frames of a video.
+// 
+// A full mr::MoonRegistrar::compute_registration() only runs on keyframes.
+// In between keyframes, inlier keypoints of the last keyframe are tracked
+// frame-to-frame with pyramidal Lucas-Kanade optical flow, and homography_matrix
+// is re-estimated from tracked points against their fixed model keypoints.
+// A new keyframe is computed when number of tracked inliers or
+// reprojection error degrade below thresholds.
+// 
+// Note:
+//   - homography_matrix maps coordinates of the whole frame to coordinates of model_image
+//     in its original size. It is not affected by mr::sync_img_size().
+//   - on keyframes, the moon is located by mr::MoonDetector, and only the moon part
+//     of the frame is registered.
+EXPORT_SYMBOL typedef class MoonRegistrationTracker
+{
+public:
+    // constructors
+    
+    EXPORT_SYMBOL MoonRegistrationTracker();
+    
+    EXPORT_SYMBOL MoonRegistrationTracker(
+        const cv::Mat& model_image,
+        const mr::RegistrationAlgorithms& algorithm
+    );
+    
+    
+    // setters
+    
+    // (re)init model_image, this will reset the tracker
+    EXPORT_SYMBOL void update_model_image(const cv::Mat& model_image);
+    
+    // (re)init f2d_detector of internal mr::MoonRegistrar with pre-defined algorithms
+    EXPORT_SYMBOL void update_f2d_detector(const mr::RegistrationAlgorithms& algorithm);
+    
+    // update thresholds for re-anchoring (computing a new keyframe)
+    // 
+    // Parameters:
+    //   - min_inlier_count: compute a new keyframe when number of tracked inliers < min_inlier_count.
+    //     default 20
+    //   - max_reprojection_error: compute a new keyframe when mean reprojection error (in pixels)
+    //     of tracked inliers > max_reprojection_error. default 3.0
+    //   - max_keyframe_interval: compute a new keyframe after this many tracked frames,
+    //     set it to a value <= 0 to disable it. default -1
+    EXPORT_SYMBOL void update_reanchor_threshold(
+        const int min_inlier_count = 20,
+        const double max_reprojection_error = 3.0,
+        const int max_keyframe_interval = -1
+    );
+    
+    // drop all tracked keypoints, next call to track() will compute a new keyframe
+    EXPORT_SYMBOL void reset();
+    
+    
+    // getters
+    
+    EXPORT_SYMBOL const cv::Mat& get_homography_matrix() const
+    {
+        return this->homography_matrix;
+    }
+    
+    EXPORT_SYMBOL const std::vector<cv::Point2f>& get_tracked_user_points() const
+    {
+        return this->tracked_user_pts;
+    }
+    
+    EXPORT_SYMBOL const std::vector<cv::Point2f>& get_tracked_model_points() const
+    {
+        return this->tracked_model_pts;
+    }
+    
+    EXPORT_SYMBOL int get_inlier_count() const
+    {
+        return static_cast<int>(this->tracked_user_pts.size());
+    }
+    
+    EXPORT_SYMBOL double get_reprojection_error() const
+    {
+        return this->reprojection_error;
+    }
+    
+    // whether last call to track() computed a new keyframe
+    EXPORT_SYMBOL bool is_keyframe() const
+    {
+        return this->keyframe;
+    }
+    
+    // internal mr::MoonRegistrar used for keyframes,
+    // you can use it to customize keyframe registration
+    EXPORT_SYMBOL mr::MoonRegistrar& get_registrar()
+    {
+        return this->registrar;
+    }
+    
+    
+    // tracking
+    
+    // Track moon registration on a new frame.
+    // 
+    // Parameters:
+    //   - frame: input frame, colors MUST in BGR order.
+    //     All the frames should have the same size, a size change will trigger a new keyframe.
+    // 
+    // Returns:
+    //   - true if homography_matrix is valid for input frame
+    //   - false if tracking is lost and a new keyframe cannot be computed
+    EXPORT_SYMBOL bool track(const cv::Mat& frame);
+    
+    // Using homography_matrix inverse to transform layer_image_in to the perspective of last frame.
+    // layer_image_in will be sync with model_image first.
+    // 
+    // Parameters:
+    //   - layer_image_in: input image
+    //   - layer_image_out: output image, it has the same size as last frame
+    EXPORT_SYMBOL void transform_layer_image(const cv::Mat& layer_image_in, cv::Mat& layer_image_out);
+    
+private: // helper functions
+    bool __compute_keyframe(const cv::Mat& frame);
+    bool __track_points(const std::vector<cv::Mat>& pyramid);
+    
+private:
+    mr::MoonRegistrar registrar;
+    cv::Mat model_image;
+    cv::Mat homography_matrix;
+    double reprojection_error = 0.0;
+    bool keyframe = false;
+    
+    // tracking state
+    cv::Size frame_size;
+    std::vector<cv::Mat> prev_pyramid;
+    std::vector<cv::Point2f> tracked_user_pts;
+    std::vector<cv::Point2f> tracked_model_pts;
+    int frames_since_keyframe = 0;
+    
+    // parameters
+    int min_inlier_count = 20;
+    double max_reprojection_error = 3.0;
+    int max_keyframe_interval = -1;
+    cv::Size lk_window_size = cv::Size(21, 21);
+    int lk_max_level = 3;
+    
+} MoonRegistrationTracker;
+
+}
+
+#endif
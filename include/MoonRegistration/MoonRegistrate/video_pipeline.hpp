@@ -0,0 +1,253 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+#include "MoonRegistration/shapes.hpp"
+
+#include "MoonRegistration/MoonDetect/detector.hpp"
+#include "MoonRegistration/MoonRegistrate/registrar.hpp"
+#include "MoonRegistration/MoonRegistrate/batch.hpp"
+
+
+namespace mr
+{
+
+// stages of mr::VideoPipeline, in order
+EXPORT_SYMBOL typedef enum class VideoPipelineStage
+{
+    CAPTURE                            = 0,
+    DETECT                             = 1,
+    REGISTER                           = 2,
+    COMPOSITE                          = 3,
+} VideoPipelineStage;
+
+// number of stages of mr::VideoPipeline
+const int VIDEO_PIPELINE_STAGE_COUNT = 4;
+
+// A frame flowing through mr::VideoPipeline, every stage fills its part.
+EXPORT_SYMBOL typedef struct VideoPipelineFrame
+{
+    // index of frame from frame source, starts from 0
+    int64_t frame_index = -1;
+    
+    // time when the frame is captured
+    std::chrono::steady_clock::time_point capture_time;
+    
+    // captured frame, layer image is drawn on top of it in COMPOSITE stage
+    cv::Mat frame;
+    
+    // gray version of frame, filled in DETECT stage
+    cv::Mat gray_frame;
+    
+    // moon circle & moon crop rectangle in frame, filled in DETECT stage
+    mr::Circle circle = {-1, -1, -1};
+    mr::Rectangle crop_rect = {0, 0, 0, 0};
+    
+    // homography matrix maps moon crop to model image synced with crop size,
+    // same as mr::MoonRegistrar, filled in REGISTER stage
+    cv::Mat homography_matrix;
+    
+    // whether the moon is detected & registered, if false, see error_message
+    bool success = false;
+    std::string error_message;
+    
+} VideoPipelineFrame;
+
+// per stage counters of mr::VideoPipeline
+EXPORT_SYMBOL typedef struct VideoPipelineStageStats
+{
+    // number of frames processed by this stage
+    uint64_t processed = 0;
+    
+    // number of frames dropped before this stage could take them,
+    // because a newer frame arrived first
+    uint64_t dropped = 0;
+    
+    // mean time (in milliseconds) this stage spent on a frame
+    double mean_latency_ms = 0.0;
+    
+    // processed frames per second since start()
+    double throughput_fps = 0.0;
+    
+} VideoPipelineStageStats;
+
+// Single slot lock-free mailbox between two stages of mr::VideoPipeline.
+// Pushing a frame replaces the one waiting in the slot, so a slow consumer
+// always takes the latest frame and stale frames are dropped.
+EXPORT_SYMBOL typedef class VideoPipelineSlot
+{
+public:
+    EXPORT_SYMBOL VideoPipelineSlot() {}
+    EXPORT_SYMBOL ~VideoPipelineSlot();
+    
+    VideoPipelineSlot(const VideoPipelineSlot&) = delete;
+    VideoPipelineSlot& operator=(const VideoPipelineSlot&) = delete;
+    
+    // Put a frame into the slot.
+    // 
+    // Returns:
+    //   - true if a frame waiting in the slot is dropped
+    EXPORT_SYMBOL bool push(std::unique_ptr<mr::VideoPipelineFrame> frame);
+    
+    // Take the frame out of the slot, returns nullptr if the slot is empty
+    EXPORT_SYMBOL std::unique_ptr<mr::VideoPipelineFrame> pop();
+    
+private:
+    std::atomic<mr::VideoPipelineFrame*> slot{nullptr};
+    
+} VideoPipelineSlot;
+
+// Run moon detection, registration and layer compositing of a video on overlapping threads.
+// 
+// Each stage (CAPTURE, DETECT, REGISTER, COMPOSITE) runs on its own thread, and stages are
+// connected by mr::VideoPipelineSlot, a bounded (single frame) lock-free queue.
+// A stage always works on the latest frame from its previous stage, frames arrive while
+// a stage is busy are dropped, so end-to-end latency stays bounded by the slowest stage.
+// 
+// Usage:
+//   cv::VideoCapture cap("video.mp4");
+//   mr::VideoPipeline pipeline(model_image, layer_image, mr::RegistrationAlgorithms::SIFT);
+//   pipeline.start([&cap](cv::Mat& frame) { return cap.read(frame); });
+//   mr::VideoPipelineFrame output;
+//   while (pipeline.is_running())
+//       if (pipeline.try_get_output(output)) { show output.frame }
+//   pipeline.stop();
+EXPORT_SYMBOL typedef class VideoPipeline
+{
+public:
+    // constructors
+    
+    // Parameters:
+    //   - model_image: model image
+    //   - layer_image: layer image drawn on top of every registered frame
+    //   - algorithm: mr::RegistrationAlgorithms used in REGISTER stage.
+    //     Keypoints & descriptors of model_image are extracted only once here,
+    //     and every frame is registered with mr::register_with_model_features().
+    //     Feature-free algorithms use internal mr::MoonRegistrar instead.
+    EXPORT_SYMBOL VideoPipeline(
+        const cv::Mat& model_image,
+        const cv::Mat& layer_image,
+        const mr::RegistrationAlgorithms& algorithm
+    );
+    
+    // stop all the threads
+    EXPORT_SYMBOL ~VideoPipeline();
+    
+    VideoPipeline(const VideoPipeline&) = delete;
+    VideoPipeline& operator=(const VideoPipeline&) = delete;
+    
+    
+    // setters
+    
+    // update how layer image is drawn in COMPOSITE stage, same as mr::stack_imgs_in_place().
+    // Only call it before start() or after stop().
+    // 
+    // Parameters:
+    //   - layer_image_transparency: a 0~1 float percentage changing layer image's transparency,
+    //     default 1.0
+    //   - filter_px: pixel value to filter in layer image. default cv::Vec4b(0,0,0,255)
+    EXPORT_SYMBOL void update_layer_params(
+        const float layer_image_transparency = 1.0,
+        const cv::Vec4b& filter_px = cv::Vec4b(0,0,0,255)
+    );
+    
+    
+    // getters
+    
+    // internal stages, only modify them before start() or after stop()
+    EXPORT_SYMBOL mr::MoonDetector& get_detector()
+    {
+        return this->detector;
+    }
+    
+    // feature-free algorithms run the whole registration with it,
+    // other algorithms only use its motion model, estimator params & estimate_homography
+    EXPORT_SYMBOL mr::MoonRegistrar& get_registrar()
+    {
+        return this->registrar;
+    }
+    
+    // whether stage threads are running,
+    // it becomes false after stop() or after frame source ends and all the frames are done
+    EXPORT_SYMBOL bool is_running() const
+    {
+        return this->running.load() && !this->stage_done[VIDEO_PIPELINE_STAGE_COUNT - 1].load();
+    }
+    
+    // snapshot of counters of a stage
+    EXPORT_SYMBOL mr::VideoPipelineStageStats get_stage_stats(const mr::VideoPipelineStage& stage) const;
+    
+    // mean time (in milliseconds) from capture to the end of COMPOSITE stage
+    EXPORT_SYMBOL double get_mean_end_to_end_latency_ms() const;
+    
+    
+    // pipeline
+    
+    // Start all the stage threads.
+    // 
+    // Parameters:
+    //   - frame_source: called from CAPTURE thread to read next frame into its argument,
+    //     returns false when there is no more frame. e.g. cv::VideoCapture::read().
+    //     colors of frames MUST in BGR order.
+    EXPORT_SYMBOL void start(const std::function<bool(cv::Mat&)>& frame_source);
+    
+    // stop all the stage threads and wait for them
+    EXPORT_SYMBOL void stop();
+    
+    // Take the latest output frame of COMPOSITE stage.
+    // 
+    // Returns:
+    //   - true if there is a new output frame since last call
+    EXPORT_SYMBOL bool try_get_output(mr::VideoPipelineFrame& frame_out);
+    
+private: // helper functions
+    void __run_capture(const std::function<bool(cv::Mat&)> frame_source);
+    void __run_stage(const mr::VideoPipelineStage stage);
+    void __process_detect(mr::VideoPipelineFrame& frame);
+    void __process_register(mr::VideoPipelineFrame& frame);
+    void __process_composite(mr::VideoPipelineFrame& frame);
+    void __record(const mr::VideoPipelineStage stage, const std::chrono::steady_clock::time_point& begin);
+    
+private:
+    // stages
+    mr::MoonDetector detector;
+    mr::MoonRegistrar registrar;
+    cv::Ptr<cv::Feature2D> f2d_detector;
+    mr::ModelFeatures model_features;
+    cv::Mat model_image;
+    cv::Mat layer_image;
+    float layer_image_transparency = 1.0f;
+    cv::Vec4b filter_px = cv::Vec4b(0,0,0,255);
+    // buffers reused by REGISTER stage
+    std::vector<cv::KeyPoint> user_keypoints;
+    cv::Mat user_descriptors;
+    mr::MatchBatch match_batch;
+    
+    // threads & slots, slots[i] is the input of stage i + 1
+    std::vector<std::thread> threads;
+    mr::VideoPipelineSlot slots[VIDEO_PIPELINE_STAGE_COUNT];
+    std::atomic<bool> running{false};
+    std::atomic<bool> stage_done[VIDEO_PIPELINE_STAGE_COUNT];
+    
+    // counters
+    std::chrono::steady_clock::time_point start_time;
+    std::atomic<uint64_t> processed[VIDEO_PIPELINE_STAGE_COUNT];
+    std::atomic<uint64_t> dropped[VIDEO_PIPELINE_STAGE_COUNT];
+    std::atomic<uint64_t> busy_us[VIDEO_PIPELINE_STAGE_COUNT];
+    std::atomic<uint64_t> end_to_end_us{0};
+    
+} VideoPipeline;
+
+}
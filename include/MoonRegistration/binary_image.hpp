@@ -0,0 +1,113 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+
+#include "MoonRegistration/macros.h"
+#include "MoonRegistration/shapes.hpp"
+
+#include "MoonRegistration/mrconfig.h"
+#include "MoonRegistration/version.hpp"
+
+
+namespace mr
+{
+
+// A black & white image packed into 1 bit per pixel.
+// 
+// Images after mr::binarize_image() only have black(0) & white(255) pixels, but they
+// still take 8 bits per pixel. mr::BinaryImage packs them 8 pixels per byte, so passes that
+// only count white pixels read 8 times less memory, and count them with popcount.
+// 
+// Note:
+//   - pixel x of a row is bit (x % 8) of byte (x / 8), lowest bit first
+//   - padding bits at the end of each row are always 0
+EXPORT_SYMBOL typedef class BinaryImage
+{
+public:
+    // constructors
+    EXPORT_SYMBOL BinaryImage();
+    
+    // pack image_in, see update_image()
+    EXPORT_SYMBOL explicit BinaryImage(const cv::Mat& image_in);
+    
+    // Pack image_in, replace previous content.
+    // 
+    // Parameters:
+    //   - image_in: single channel CV_8U image, every non-zero pixel becomes white
+    EXPORT_SYMBOL void update_image(const cv::Mat& image_in);
+    
+    // Unpack to a single channel CV_8U image.
+    // 
+    // Parameters:
+    //   - image_out: output image
+    //   - white: value of white pixels in image_out, default 255
+    EXPORT_SYMBOL void to_mat(cv::Mat& image_out, const uchar white = 255) const;
+    
+    // whether pixel (x, y) is white
+    EXPORT_SYMBOL bool at(const int y, const int x) const
+    {
+        return (this->bits.ptr<uchar>(y)[x >> 3] >> (x & 7)) & 1;
+    }
+    
+    // number of white pixels in the image
+    EXPORT_SYMBOL int count_nonzero() const;
+    
+    // Number of white pixels inside a circle.
+    // Pixels are the same as mr::calc_circle_brightness_perc() visits,
+    // the circle is clipped by the image.
+    // 
+    // Parameters:
+    //   - circle_in: input circle
+    EXPORT_SYMBOL int count_nonzero_in_circle(const mr::Circle& circle_in) const;
+    
+    
+    // getters
+    
+    EXPORT_SYMBOL bool empty() const
+    {
+        return this->bits.empty();
+    }
+    
+    // size in pixels
+    EXPORT_SYMBOL cv::Size size() const
+    {
+        return cv::Size(this->width, this->bits.rows);
+    }
+    
+    // packed bits, a CV_8UC1 image with (width + 7) / 8 bytes per row
+    EXPORT_SYMBOL const cv::Mat& get_bits() const
+    {
+        return this->bits;
+    }
+    
+private:
+    cv::Mat bits;
+    int width = 0;
+    
+} BinaryImage;
+
+// Same as mr::calc_img_brightness_perc() on the unpacked black(0) / white(255) image.
+// 
+// Parameters:
+//   - image_in: input image
+// 
+// Returns:
+//   - float between 0 to 1
+EXPORT_SYMBOL float calc_img_brightness_perc(
+    const mr::BinaryImage& image_in
+);
+
+// Same as mr::calc_circle_brightness_perc() on the unpacked black(0) / white(255) image.
+// 
+// Parameters:
+//   - image_in: input image
+//   - circle_in: input circle
+// 
+// Returns:
+//   - float between 0 to 1
+EXPORT_SYMBOL float calc_circle_brightness_perc(
+    const mr::BinaryImage& image_in,
+    const mr::Circle& circle_in
+);
+
+}
@@ -16,6 +16,7 @@ extern "C" {
 #define MRC_ORB                       0x101
 #define MRC_AKAZE                     0x102
 #define MRC_BRISK                     0x103
+#define MRC_FOURIER_MELLIN            0x300
 #define MRC_EMPTY_ALGORITHM           0x001
 #define MRC_INVALID_ALGORITHM         0x000
 
@@ -27,7 +28,7 @@ extern "C" {
 //   - model_image: a mat_ptr to model image, you can read image using mrc_read_image_from_... functions
 //   - layer_image: a mat_ptr to layer image, you can read image using mrc_read_image_from_... functions
 //   - mrc_algorithm: int value representing mr::RegistrationAlgorithms, can be:
-//     MRC_SIFT, MRC_ORB, MRC_AKAZE, MRC_BRISK, MRC_EMPTY_ALGORITHM, MRC_INVALID_ALGORITHM
+//     MRC_SIFT, MRC_ORB, MRC_AKAZE, MRC_BRISK, MRC_FOURIER_MELLIN, MRC_EMPTY_ALGORITHM, MRC_INVALID_ALGORITHM
 //   - layer_image_transparency: a 0~1 float percentage changing layer image's transparency
 //   - filter_px: 4 1-byte numbers representing BGRA value of a pixel, function will use it
 //     to filter the pixel in layer image. A pixel will be ignore when all of its values
@@ -53,6 +54,47 @@ EXPORT_SYMBOL mat_ptr mrc_registrar_draw_layer_image(
     char** error_message
 );
 
+// pointer to a mr::LayerAsset
+EXPORT_SYMBOL typedef void* layer_asset_ptr;
+
+// Build a mr::LayerAsset from layer image, so it can be drawn many times
+// without preprocessing it again
+// 
+// Parameters:
+//   - layer_image: a mat_ptr to layer image, you can read image using mrc_read_image_from_... functions
+//   - max_levels: maximum number of pyramid levels, set it to a value <= 0 to build all the levels
+//   - error_message: pointer to string buffer for error_message, set it to NULL if you don't need it
+// 
+// Returns:
+//   - if success, return a layer_asset_ptr, destroy it with mrc_destroy_layer_asset_ptr()
+//   - if fail, return NULL and set error_message to a string.
+EXPORT_SYMBOL layer_asset_ptr mrc_create_layer_asset(
+    mat_ptr layer_image,
+    const int max_levels,
+    char** error_message
+);
+
+EXPORT_SYMBOL void mrc_destroy_layer_asset_ptr(layer_asset_ptr ptr);
+
+// Same as mrc_registrar_draw_layer_image(), but draw a mr::LayerAsset
+// 
+// Parameters:
+//   - layer_asset: a layer_asset_ptr created by mrc_create_layer_asset()
+//   - rest of parameters are the same as mrc_registrar_draw_layer_image()
+// 
+// Returns:
+//   - if success, return a mat_ptr.
+//   - if fail, return NULL and set error_message to a string.
+EXPORT_SYMBOL mat_ptr mrc_registrar_draw_layer_asset(
+    mat_ptr user_image,
+    mat_ptr model_image,
+    layer_asset_ptr layer_asset,
+    const int mrc_algorithm,
+    const float layer_image_transparency,
+    const unsigned char* filter_px,
+    char** error_message
+);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -62,6 +62,79 @@ EXPORT_SYMBOL void apply_brightness_contrast(
     int contrast        = 0
 );
 
+// A chain of 8-bit per-pixel point operations compiled into one 256 entries lookup table.
+// 
+// Every operation appended to the chain is folded into the table right away,
+// so apply() runs the whole chain in a single cv::LUT() pass, no matter how many
+// operations the chain has. Results are the same as running the operations one by one
+// on a CV_8U image.
+// 
+// Usage:
+//   mr::PointOpChain chain;
+//   chain.threshold(7, 255, cv::THRESH_TOZERO).threshold(204, 255, cv::THRESH_TRUNC).binarize();
+//   chain.apply(image_in, image_out);
+EXPORT_SYMBOL typedef class PointOpChain
+{
+public:
+    // constructors
+    
+    // identity chain, maps every pixel to itself
+    EXPORT_SYMBOL PointOpChain();
+    
+    
+    // chain builders, all of them return *this
+    
+    // Append cv::threshold() on CV_8U.
+    // 
+    // Parameters:
+    //   - thresh: threshold value
+    //   - maxval: maximum value for cv::THRESH_BINARY & cv::THRESH_BINARY_INV
+    //   - type: cv::THRESH_BINARY, cv::THRESH_BINARY_INV, cv::THRESH_TRUNC,
+    //     cv::THRESH_TOZERO, or cv::THRESH_TOZERO_INV. cv::THRESH_OTSU & cv::THRESH_TRIANGLE
+    //     depend on image content and are not supported.
+    EXPORT_SYMBOL PointOpChain& threshold(const double thresh, const double maxval, const int type);
+    
+    // Append mr::apply_brightness_contrast().
+    // 
+    // Parameters:
+    //   - brightness: image brightness value (-127 to 127) (default 0)
+    //   - contrast: image contrast value (-127 to 127) (default 0)
+    EXPORT_SYMBOL PointOpChain& brightness_contrast(const int brightness = 0, const int contrast = 0);
+    
+    // Append the point operations of mr::binarize_image(),
+    // maximum contrast followed by cv::THRESH_BINARY.
+    // 
+    // Parameters:
+    //   - thresh: threshold to separate black & white. default 0.0
+    //   - maxval: "white" pixel maximum value. default 255.0
+    EXPORT_SYMBOL PointOpChain& binarize(const double thresh = 0.0, const double maxval = 255.0);
+    
+    // Append all the operations of another chain
+    EXPORT_SYMBOL PointOpChain& append(const PointOpChain& other);
+    
+    // reset to identity chain
+    EXPORT_SYMBOL void reset();
+    
+    
+    // Apply the chain to every channel of image_in in one pass.
+    // image_in & image_out can be the same cv::Mat.
+    // 
+    // Parameters:
+    //   - image_in: CV_8U input image with any number of channels
+    //   - image_out: output image, same size & type as image_in
+    EXPORT_SYMBOL void apply(const cv::Mat& image_in, cv::Mat& image_out) const;
+    
+    // compiled table, a 1x256 CV_8U view of internal data
+    EXPORT_SYMBOL cv::Mat get_lut() const
+    {
+        return cv::Mat(1, 256, CV_8U, const_cast<uchar*>(this->table));
+    }
+    
+private:
+    uchar table[256];
+    
+} PointOpChain;
+
 // Assuming all pixel values in image_in are black(0) / white(255)
 // sum up all the pixels in given image, and then
 // calculate its mean. The return value represents
@@ -95,7 +168,8 @@ EXPORT_SYMBOL float calc_circle_brightness_perc(
     const mr::Circle& circle_in
 );
 
-// Binarize input image, make it black & white only
+// Binarize input image, make it black & white only.
+// For CV_8U images, contrast & threshold are applied in one lookup table pass (mr::PointOpChain).
 // 
 // Parameters:
 //   - image_in: input image
@@ -109,6 +183,19 @@ EXPORT_SYMBOL void binarize_image(
     double maxval = 255.0
 );
 
+// Create a single channel mask with a filled circle,
+// pixels inside the circle are 255 and pixels outside are 0.
+// 
+// Parameters:
+//   - size: mask size
+//   - circle_in: mr::Circle input, it can go out of bound of the mask
+//   - mask_out: output CV_8UC1 mask
+EXPORT_SYMBOL void create_circle_mask(
+    const cv::Size& size,
+    const mr::Circle& circle_in,
+    cv::Mat& mask_out
+);
+
 // Cut a square image using input circle and output a cv::Mat reference to input
 // 
 // Parameters:
@@ -125,7 +212,8 @@ EXPORT_SYMBOL void cut_ref_image_from_circle(
     const int padding             = 15
 );
 
-// Cut a square image using input circle and output it as a cv::Mat copy of input
+// Cut a square image using input circle and output it as a cv::Mat copy of input.
+// If the crop is only read, use mr::cut_ref_image_from_circle() to skip the copy.
 // 
 // Parameters:
 //   - image_in: input image
@@ -162,6 +250,36 @@ EXPORT_SYMBOL void sync_img_size(const cv::Mat& primary, cv::Mat& secondary);
 //   - secondary: image to sync with primary
 EXPORT_SYMBOL void sync_img_size(const int primary_width, const int primary_height, cv::Mat& secondary);
 
+// Compute the size of secondary image after mr::sync_img_size(),
+// without resizing any image.
+// 
+// Parameters:
+//   - primary_width: image width for sync reference
+//   - primary_height: image height for sync reference
+//   - secondary_size: size of image to sync with primary
+// 
+// Returns:
+//   - cv::Size of secondary image after sync
+EXPORT_SYMBOL cv::Size calc_sync_img_size(const int primary_width, const int primary_height, const cv::Size& secondary_size);
+
+// Apply a 3x3 homography matrix to image_in.
+// When the last row of homography_matrix is (0, 0, 1), it is an affine transformation,
+// and cv::warpAffine() is used instead of cv::warpPerspective(), which is cheaper.
+// 
+// Parameters:
+//   - image_in: input image
+//   - image_out: output image
+//   - homography_matrix: 3x3 homography matrix
+//   - size: output image size
+//   - flags: interpolation flags for cv::warpPerspective() / cv::warpAffine(). default INTER_LINEAR
+EXPORT_SYMBOL void warp_image(
+    const cv::Mat& image_in,
+    cv::Mat& image_out,
+    const cv::Mat& homography_matrix,
+    const cv::Size& size,
+    const int flags = cv::INTER_LINEAR
+);
+
 // Sync the number of channels of secondary image to primary image
 // 
 // Parameters:
@@ -6,6 +6,7 @@
 #include "MoonRegistration/version.hpp"
 
 #include "MoonRegistration/imgprocess.hpp"
+#include "MoonRegistration/binary_image.hpp"
 #include "MoonRegistration/shapes.hpp"
 #include "MoonRegistration/utils.hpp"
 
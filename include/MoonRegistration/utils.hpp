@@ -190,4 +190,32 @@ EXPORT_SYMBOL double norm_kp(
     const int method = cv::NORM_L2
 );
 
+// Compute a 3x3 scale matrix mapping coordinates of an image with src_size
+// to coordinates of the same image resized to dst_size.
+// Pixel centers are mapped onto pixel centers the same way as cv::resize(),
+// so p_dst = s * p_src + 0.5 * s - 0.5 on each axis
+// 
+// Parameters:
+//   - src_size: cv::Size, size of source image
+//   - dst_size: cv::Size, size of destination image
+// 
+// Returns:
+//   - cv::Matx33d scale matrix with s = dst / src on the diagonal and the half pixel offset
+//     0.5 * s - 0.5 in the last column
+EXPORT_SYMBOL cv::Matx33d calc_scale_matrix(
+    const cv::Size& src_size,
+    const cv::Size& dst_size
+);
+
+// Rescale keypoints coordinates & sizes in-place using a scale matrix
+// from mr::calc_scale_matrix(), coordinates are mapped with the whole matrix
+// 
+// Parameters:
+//   - keypoints: std::vector<cv::KeyPoint> to rescale
+//   - scale_matrix: cv::Matx33d scale matrix
+EXPORT_SYMBOL void rescale_keypoints(
+    std::vector<cv::KeyPoint>& keypoints,
+    const cv::Matx33d& scale_matrix
+);
+
 }
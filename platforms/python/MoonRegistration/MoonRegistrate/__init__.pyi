@@ -79,6 +79,7 @@ if MR_HAVE_OPENCV_NONFREE:
         # opencv non-free algorithms
         SURF_NONFREE                       = 0x200,
     #endif
+        FOURIER_MELLIN                     = 0x300,
         EMPTY_ALGORITHM                    = 0x001,
         INVALID_ALGORITHM                  = 0x000
 else:
@@ -88,6 +89,7 @@ else:
         AKAZE                              = 0x102,
         BRISK                              = 0x103,
         
+        FOURIER_MELLIN                     = 0x300,
         EMPTY_ALGORITHM                    = 0x001,
         INVALID_ALGORITHM                  = 0x000
 
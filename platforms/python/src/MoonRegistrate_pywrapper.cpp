@@ -365,6 +365,7 @@ void init_MoonRegistrate(py::module &module)
 #ifdef MR_HAVE_OPENCV_NONFREE
         .value("SURF_NONFREE", mr::RegistrationAlgorithms::SURF_NONFREE)
 #endif
+        .value("FOURIER_MELLIN", mr::RegistrationAlgorithms::FOURIER_MELLIN)
         .value("EMPTY_ALGORITHM", mr::RegistrationAlgorithms::EMPTY_ALGORITHM)
         .value("INVALID_ALGORITHM", mr::RegistrationAlgorithms::INVALID_ALGORITHM)
     ;
@@ -643,7 +644,9 @@ void init_MoonRegistrate(py::module &module)
       - user_image: a const reference to user_image
       - model_image: a const reference to model_image
     
-    function pointer default points to mr::default_is_good_match()
+    When it is set, it is used instead of the batch filter
+    mr::MoonRegistrar::filter_good_matches, which defaults to
+    mr::default_filter_good_matches(), the batch version of mr::default_is_good_match()
         )pbdoc"
         )
     ;
@@ -11,6 +11,34 @@
 namespace mr
 {
 
+// point operations shared by default preprocess steps:
+// turn 0-3% white pixel to black, and then turn 80-100% white pixel to 80% white
+static const mr::PointOpChain& default_clip_point_ops()
+{
+    static const mr::PointOpChain point_ops = mr::PointOpChain()
+        .threshold(static_cast<int>(255*0.03), 255, cv::THRESH_TOZERO)
+        .threshold(static_cast<int>(255*0.8), 255, cv::THRESH_TRUNC);
+    return point_ops;
+}
+
+// whether image_in only has black(0) & white(255) pixels,
+// mr::BinaryImage treats every non-zero pixel as white, so it only matches cv::Mat results on these images
+static bool is_black_white_image(const cv::Mat& image_in)
+{
+    if (image_in.empty() || image_in.type() != CV_8UC1)
+        return false;
+    for (int y = 0; y < image_in.rows; ++y)
+    {
+        const uchar* row = image_in.ptr<uchar>(y);
+        for (int x = 0; x < image_in.cols; ++x)
+        {
+            if (row[x] != 0 && row[x] != 255)
+                return false;
+        }
+    }
+    return true;
+}
+
 // HOUGH_GRADIENT (HG)
 
 EXPORT_SYMBOL void HG_default_preprocess_steps(
@@ -25,11 +53,20 @@ EXPORT_SYMBOL void HG_default_preprocess_steps(
     // so we can rescale the output x/y coordinate back to match original image
     mr::resize_with_aspect_ratio(image_in, buff, resize_ratio_out, -1, -1, 500);
     
-    // creating gray scale version of image needed for HoughCircles
-    cv::cvtColor(buff, buff, cv::COLOR_BGR2GRAY);
+    // creating gray scale version of image needed for HoughCircles,
+    // gray input is used as is, so callers can share their gray image
+    cv::Mat gray;
+    if (buff.channels() == 1)
+        gray = buff;
+    else
+        cv::cvtColor(buff, gray, cv::COLOR_BGR2GRAY);
     
     // rm detail texture
-    cv::bilateralFilter(buff.clone(), buff, 10, 50, 50);
+    // bilateralFilter cannot run in place, filter into a new buffer,
+    // so a shared gray input is never modified
+    cv::Mat filtered;
+    cv::bilateralFilter(gray, filtered, 10, 50, 50);
+    buff = filtered;
     
     // add erosion to blur/remove small noices
     // https://docs.opencv.org/3.4/db/df6/tutorial_erosion_dilatation.html
@@ -47,13 +84,10 @@ EXPORT_SYMBOL void HG_default_preprocess_steps(
     double gaussian_sigmaX = 2.0;
     double gaussian_sigmaY = 2.0;
     cv::GaussianBlur(buff, buff, gaussian_ksize, gaussian_sigmaX, gaussian_sigmaY);
-    // turn 0-3% white pixel to black
-    cv::threshold(buff, buff, static_cast<int>(255*0.03), 255, cv::THRESH_TOZERO);
-    // turn 80-100% white pixel to 80% white
-    cv::threshold(buff, buff, static_cast<int>(255*0.8), 255, cv::THRESH_TRUNC);
-    
-    // make image black & white only
-    mr::binarize_image(buff, image_out);
+    // turn 0-3% white pixel to black, turn 80-100% white pixel to 80% white,
+    // and make image black & white only, all in one lookup table pass
+    static const mr::PointOpChain point_ops = mr::PointOpChain(default_clip_point_ops()).binarize();
+    point_ops.apply(buff, image_out);
 }
 
 EXPORT_SYMBOL void HG_default_param_init(
@@ -150,17 +184,40 @@ EXPORT_SYMBOL mr::Circle HG_default_iteration_circle_select(
         std::vector<cv::Vec3f> candidate_circles = mr::select_n_circles_by_largest_radius(
             image_in, detected_circles, 5
         );
-        output = mr::select_circle_by_brightness_perc(
-            image_in, candidate_circles
-        );
+        // image_in is black & white after HG_default_preprocess_steps(), so brightness perc
+        // is counted on its 1 bit per pixel version, other preprocess steps use the cv::Mat version
+        if (is_black_white_image(image_in))
+        {
+            output = mr::select_circle_by_brightness_perc(
+                mr::BinaryImage(image_in), candidate_circles
+            );
+        }
+        else
+        {
+            output = mr::select_circle_by_brightness_perc(
+                image_in, candidate_circles
+            );
+        }
     }
     else if (iteration > 0)
     {
         // find 5 circles w/ highest brightness perc
         // and then find the one with highest number of shape side
-        std::vector<cv::Vec3f> candidate_circles = mr::select_n_circles_by_brightness_perc(
-            image_in, detected_circles, 5
-        );
+        // image_in is black & white after HG_default_preprocess_steps(), so brightness perc
+        // is counted on its 1 bit per pixel version, other preprocess steps use the cv::Mat version
+        std::vector<cv::Vec3f> candidate_circles;
+        if (is_black_white_image(image_in))
+        {
+            candidate_circles = mr::select_n_circles_by_brightness_perc(
+                mr::BinaryImage(image_in), detected_circles, 5
+            );
+        }
+        else
+        {
+            candidate_circles = mr::select_n_circles_by_brightness_perc(
+                image_in, detected_circles, 5
+            );
+        }
         output = mr::select_circle_by_shape(
             image_in, candidate_circles
         );
@@ -216,11 +273,20 @@ EXPORT_SYMBOL void HGA_default_preprocess_steps(
     cv::Mat buff = image_in;
     resize_ratio_out = 1.0;
     
-    // creating gray scale version of image needed for HoughCircles
-    cv::cvtColor(buff, buff, cv::COLOR_BGR2GRAY);
+    // creating gray scale version of image needed for HoughCircles,
+    // gray input is used as is, so callers can share their gray image
+    cv::Mat gray;
+    if (buff.channels() == 1)
+        gray = buff;
+    else
+        cv::cvtColor(buff, gray, cv::COLOR_BGR2GRAY);
     
     // rm detail texture
-    cv::bilateralFilter(buff.clone(), buff, 10, 50, 50);
+    // bilateralFilter cannot run in place, filter into a new buffer,
+    // so a shared gray input is never modified
+    cv::Mat filtered;
+    cv::bilateralFilter(gray, filtered, 10, 50, 50);
+    buff = filtered;
     
     // add erosion to blur/remove small noices
     // https://docs.opencv.org/3.4/db/df6/tutorial_erosion_dilatation.html
@@ -238,10 +304,9 @@ EXPORT_SYMBOL void HGA_default_preprocess_steps(
     double gaussian_sigmaX = 2.0;
     double gaussian_sigmaY = 2.0;
     cv::GaussianBlur(buff, buff, gaussian_ksize, gaussian_sigmaX, gaussian_sigmaY);
-    // turn 0-3% white pixel to black
-    cv::threshold(buff, buff, static_cast<int>(255*0.03), 255, cv::THRESH_TOZERO);
-    // turn 80-100% white pixel to 80% white
-    cv::threshold(buff, image_out, static_cast<int>(255*0.8), 255, cv::THRESH_TRUNC);
+    // turn 0-3% white pixel to black, turn 80-100% white pixel to 80% white,
+    // in one lookup table pass
+    default_clip_point_ops().apply(buff, image_out);
 }
 
 EXPORT_SYMBOL void HGA_default_param_init(
@@ -349,11 +414,20 @@ EXPORT_SYMBOL void HGM_default_preprocess_steps(
     cv::Mat buff = image_in;
     resize_ratio_out = 1.0;
     
-    // creating gray scale version of image needed for HoughCircles
-    cv::cvtColor(buff, buff, cv::COLOR_BGR2GRAY);
+    // creating gray scale version of image needed for HoughCircles,
+    // gray input is used as is, so callers can share their gray image
+    cv::Mat gray;
+    if (buff.channels() == 1)
+        gray = buff;
+    else
+        cv::cvtColor(buff, gray, cv::COLOR_BGR2GRAY);
     
     // rm detail texture
-    cv::bilateralFilter(buff.clone(), buff, 10, 50, 50);
+    // bilateralFilter cannot run in place, filter into a new buffer,
+    // so a shared gray input is never modified
+    cv::Mat filtered;
+    cv::bilateralFilter(gray, filtered, 10, 50, 50);
+    buff = filtered;
     
     // add erosion to blur/remove small noices
     // https://docs.opencv.org/3.4/db/df6/tutorial_erosion_dilatation.html
@@ -371,10 +445,9 @@ EXPORT_SYMBOL void HGM_default_preprocess_steps(
     double gaussian_sigmaX = 2.0;
     double gaussian_sigmaY = 2.0;
     cv::GaussianBlur(buff, buff, gaussian_ksize, gaussian_sigmaX, gaussian_sigmaY);
-    // turn 0-3% white pixel to black
-    cv::threshold(buff, buff, static_cast<int>(255*0.03), 255, cv::THRESH_TOZERO);
-    // turn 80-100% white pixel to 80% white
-    cv::threshold(buff, image_out, static_cast<int>(255*0.8), 255, cv::THRESH_TRUNC);
+    // turn 0-3% white pixel to black, turn 80-100% white pixel to 80% white,
+    // in one lookup table pass
+    default_clip_point_ops().apply(buff, image_out);
 }
 
 EXPORT_SYMBOL void HGM_default_param_init(
@@ -477,13 +550,15 @@ EXPORT_SYMBOL mr::Circle HGM_default_iteration_circle_select(
     if (iteration < (max_iteration - 1) && !detected_circles.empty())
     {
         cv::Mat image_bin;
-        // binarize image first before running selection algorithms
+        // binarize image first before running selection algorithms,
+        // and pack it to 1 bit per pixel for brightness perc
         mr::binarize_image(image_in, image_bin, static_cast<int>(255 * 0.05));
+        mr::BinaryImage image_bits(image_bin);
         
         // find 5 circles by brightness perc
         // and then find the one with largest radius
         std::vector<cv::Vec3f> candidate_circles = mr::select_n_circles_by_brightness_perc(
-            image_bin, detected_circles, 5
+            image_bits, detected_circles, 5
         );
         output = mr::select_circle_by_largest_radius(
             image_bin, candidate_circles
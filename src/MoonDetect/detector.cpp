@@ -98,6 +98,13 @@ EXPORT_SYMBOL void MoonDetector::init_by_mat(const cv::Mat& image_in)
         throw std::runtime_error("Empty Input Image");
 }
 
+EXPORT_SYMBOL void MoonDetector::init_by_mat_view(const cv::Mat& image_in)
+{
+    if (image_in.empty())
+        throw std::runtime_error("Empty Input Image");
+    this->original_image = image_in;
+}
+
 EXPORT_SYMBOL void MoonDetector::update_hough_circles_algorithm(const mr::HoughCirclesAlgorithms& algorithm)
 {
     switch (algorithm)
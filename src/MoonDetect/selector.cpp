@@ -6,8 +6,10 @@
 namespace mr
 {
 
-EXPORT_SYMBOL mr::Circle select_circle_by_brightness_perc(
-    const cv::Mat& image_in,
+// shared by cv::Mat & mr::BinaryImage overloads
+template <class IMAGE>
+static mr::Circle select_circle_by_brightness_perc_impl(
+    const IMAGE& image_in,
     const std::vector<cv::Vec3f>& detected_circles
 )
 {
@@ -23,7 +25,7 @@ EXPORT_SYMBOL mr::Circle select_circle_by_brightness_perc(
         {
             veci = mr::round_vec3f(vec);
             // calc circle brightness percentage (pixel mean)
-            float mean = calc_circle_brightness_perc(
+            float mean = mr::calc_circle_brightness_perc(
                 image_in,
                 {veci[0], veci[1], veci[2]}
             );
@@ -41,8 +43,10 @@ EXPORT_SYMBOL mr::Circle select_circle_by_brightness_perc(
     return {x,y,radius};
 }
 
-EXPORT_SYMBOL std::vector<cv::Vec3f> select_n_circles_by_brightness_perc(
-    const cv::Mat& image_in,
+// shared by cv::Mat & mr::BinaryImage overloads
+template <class IMAGE>
+static std::vector<cv::Vec3f> select_n_circles_by_brightness_perc_impl(
+    const IMAGE& image_in,
     const std::vector<cv::Vec3f>& detected_circles,
     int n
 )
@@ -61,7 +65,7 @@ EXPORT_SYMBOL std::vector<cv::Vec3f> select_n_circles_by_brightness_perc(
         [&image_in, &veci](const cv::Vec3f& vec) {
             veci = mr::round_vec3f(vec);
             // calc circle brightness percentage (pixel mean)
-            return calc_circle_brightness_perc(
+            return mr::calc_circle_brightness_perc(
                 image_in,
                 {veci[0], veci[1], veci[2]}
             );
@@ -73,6 +77,40 @@ EXPORT_SYMBOL std::vector<cv::Vec3f> select_n_circles_by_brightness_perc(
     return result;
 }
 
+EXPORT_SYMBOL mr::Circle select_circle_by_brightness_perc(
+    const cv::Mat& image_in,
+    const std::vector<cv::Vec3f>& detected_circles
+)
+{
+    return select_circle_by_brightness_perc_impl(image_in, detected_circles);
+}
+
+EXPORT_SYMBOL mr::Circle select_circle_by_brightness_perc(
+    const mr::BinaryImage& image_in,
+    const std::vector<cv::Vec3f>& detected_circles
+)
+{
+    return select_circle_by_brightness_perc_impl(image_in, detected_circles);
+}
+
+EXPORT_SYMBOL std::vector<cv::Vec3f> select_n_circles_by_brightness_perc(
+    const cv::Mat& image_in,
+    const std::vector<cv::Vec3f>& detected_circles,
+    int n
+)
+{
+    return select_n_circles_by_brightness_perc_impl(image_in, detected_circles, n);
+}
+
+EXPORT_SYMBOL std::vector<cv::Vec3f> select_n_circles_by_brightness_perc(
+    const mr::BinaryImage& image_in,
+    const std::vector<cv::Vec3f>& detected_circles,
+    int n
+)
+{
+    return select_n_circles_by_brightness_perc_impl(image_in, detected_circles, n);
+}
+
 EXPORT_SYMBOL mr::Circle select_circle_by_largest_radius(
     const cv::Mat& image_in,
     const std::vector<cv::Vec3f>& detected_circles
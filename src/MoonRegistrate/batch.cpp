@@ -0,0 +1,318 @@
+#include <opencv2/imgproc.hpp>
+
+#include <exception>
+#include <thread>
+#include <atomic>
+#include <system_error>
+#include <cmath>
+
+#include "MoonRegistration/MoonRegistrate/batch.hpp"
+#include "MoonRegistration/imgprocess.hpp"
+#include "MoonRegistration/utils.hpp"
+
+
+namespace mr
+{
+
+EXPORT_SYMBOL void extract_model_features(
+    const cv::Mat& model_image,
+    cv::Ptr<cv::Feature2D>& f2d_detector,
+    mr::ModelFeatures& features_out,
+    const bool compact_model_descriptors,
+    const int model_descriptor_pca_components,
+    const std::function<cv::Mat(
+        const std::vector<cv::Point2f>&,
+        const std::vector<cv::Point2f>&,
+        const std::vector<float>&,
+        const mr::EstimatorParams&,
+        std::vector<unsigned char>&
+    )>& estimate_homography,
+    const mr::EstimatorParams& estimator_params
+)
+{
+    if (model_image.empty())
+        throw std::runtime_error("Input Model Image is empty");
+    if (f2d_detector.empty())
+        throw std::runtime_error("Empty Feature2D detector");
+    
+    features_out.image = model_image;
+    features_out.compact_descriptors = mr::CompactDescriptors();
+    cv::Mat gray_model_image;
+    cv::cvtColor(model_image, gray_model_image, cv::COLOR_BGR2GRAY);
+    f2d_detector->detectAndCompute(
+        gray_model_image, cv::noArray(), features_out.keypoints, features_out.descriptors
+    );
+    if (compact_model_descriptors && !features_out.descriptors.empty())
+    {
+        features_out.compact_descriptors.compress(features_out.descriptors, model_descriptor_pca_components);
+        features_out.descriptors.release();
+    }
+}
+
+EXPORT_SYMBOL void extract_user_features(
+    const cv::Mat& user_image,
+    cv::Ptr<cv::Feature2D>& f2d_detector,
+    std::vector<cv::KeyPoint>& user_keypoints,
+    cv::Mat& user_descriptors
+)
+{
+    if (user_image.empty())
+        throw std::runtime_error("Input User Image is empty");
+    if (f2d_detector.empty())
+        throw std::runtime_error("Empty Feature2D detector");
+    
+    cv::Mat gray_user_image;
+    cv::cvtColor(user_image, gray_user_image, cv::COLOR_BGR2GRAY);
+    f2d_detector->detectAndCompute(
+        gray_user_image, cv::noArray(), user_keypoints, user_descriptors
+    );
+}
+
+EXPORT_SYMBOL void register_with_model_features(
+    const mr::ModelFeatures& model,
+    const cv::Mat& user_image,
+    const std::vector<cv::KeyPoint>& user_keypoints,
+    const cv::Mat& user_descriptors,
+    mr::MatchBatch& match_batch,
+    mr::RegistrationResult& result,
+    const cv::Mat& layer_image,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px,
+    const int knn_k,
+    const float good_match_ratio,
+    const int find_homography_method,
+    const double find_homography_ransac_reproj_threshold,
+    const std::function<bool(
+        const cv::DMatch&,
+        const cv::DMatch&,
+        const float,
+        const cv::KeyPoint&,
+        const cv::KeyPoint&,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& is_good_match,
+    const std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& filter_good_matches,
+    const std::function<cv::Mat(
+        const std::vector<cv::Point2f>&,
+        const std::vector<cv::Point2f>&,
+        const std::vector<float>&,
+        const mr::EstimatorParams&,
+        std::vector<unsigned char>&
+    )>& estimate_homography,
+    const mr::EstimatorParams& estimator_params
+)
+{
+    if (user_image.empty())
+        throw std::runtime_error("Input User Image is empty");
+    result = mr::RegistrationResult();
+    
+    // matching keypoints against pre-computed model descriptors
+    std::vector<std::vector<cv::DMatch>> matches;
+    if (!model.compact_descriptors.empty())
+        model.compact_descriptors.knn_match(user_descriptors, matches, knn_k);
+    else
+    {
+        cv::BFMatcher bf_matcher;
+        bf_matcher.knnMatch(user_descriptors, model.descriptors, matches, knn_k);
+    }
+    
+    // filter good matches, model keypoints are in original model image coordinate
+    std::vector<cv::Point2f> user_pts, model_pts;
+    std::vector<cv::DMatch> good_matches;
+    mr::select_good_matches(
+        matches, user_keypoints, model.keypoints,
+        user_image, model.image,
+        good_match_ratio,
+        is_good_match, filter_good_matches,
+        match_batch,
+        good_matches, user_pts, model_pts
+    );
+    std::vector<float> match_distances;
+    match_distances.reserve(good_matches.size());
+    for (const auto& match : good_matches)
+        match_distances.push_back(match.distance);
+    result.good_match_count = static_cast<int>(user_pts.size());
+    
+    // compute homography matrix, same as mr::MoonRegistrar::compute_registration()
+    size_t min_points = static_cast<size_t>(mr::min_points_of_motion_model(estimator_params.motion_model));
+    if (user_pts.size() < min_points)
+        throw std::runtime_error("No enough keypoints for finding homography matrix");
+    if (!estimate_homography)
+        throw std::runtime_error("Empty estimate_homography");
+    mr::EstimatorParams params = estimator_params;
+    params.method = find_homography_method;
+    params.ransac_reproj_threshold = find_homography_ransac_reproj_threshold;
+    std::vector<unsigned char> inlier_mask;
+    cv::Mat homography = estimate_homography(user_pts, model_pts, match_distances, params, inlier_mask);
+    if (homography.empty())
+        throw std::runtime_error("Cannot find Homography Matrix");
+    
+    // mr::MoonRegistrar syncs model image with user image size,
+    // convert homography matrix so it maps user image to synced model image
+    cv::Size synced_model_size = mr::calc_sync_img_size(
+        user_image.cols, user_image.rows, model.image.size()
+    );
+    cv::Matx33d model_scale = mr::calc_scale_matrix(model.image.size(), synced_model_size);
+    cv::Matx33d native_homography = homography;
+    result.homography_matrix = cv::Mat(model_scale * native_homography);
+    
+    // inlier count & reprojection error in synced model image coordinate
+    std::vector<cv::Point2f> projected_pts;
+    cv::perspectiveTransform(user_pts, projected_pts, result.homography_matrix);
+    double error_sum = 0.0;
+    int inlier_count = 0;
+    // custom estimators may not output inlier mask, all the points are inliers then
+    bool has_inlier_mask = (inlier_mask.size() == user_pts.size());
+    for (size_t i = 0; i < projected_pts.size(); ++i)
+    {
+        if (has_inlier_mask && !inlier_mask[i])
+            continue;
+        cv::Point2f diff(
+            projected_pts[i].x - (model_pts[i].x * static_cast<float>(model_scale(0, 0)) + static_cast<float>(model_scale(0, 2))),
+            projected_pts[i].y - (model_pts[i].y * static_cast<float>(model_scale(1, 1)) + static_cast<float>(model_scale(1, 2)))
+        );
+        error_sum += std::sqrt(diff.x * diff.x + diff.y * diff.y);
+        ++inlier_count;
+    }
+    result.inlier_count = inlier_count;
+    result.reprojection_error = (inlier_count > 0) ? (error_sum / inlier_count) : 0.0;
+    
+    // optionally draw layer image on top of user image
+    if (!layer_image.empty())
+    {
+        mr::draw_layer_image(
+            user_image, result.homography_matrix,
+            layer_image, result.layer_image_out,
+            layer_image_transparency, filter_px
+        );
+    }
+    
+    result.success = true;
+}
+
+EXPORT_SYMBOL void register_batch(
+    const cv::Mat& model_image,
+    const std::vector<cv::Mat>& user_images,
+    const mr::RegistrationAlgorithms& algorithm,
+    std::vector<mr::RegistrationResult>& results,
+    const cv::Mat& layer_image,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px,
+    const int num_threads,
+    const int knn_k,
+    const float good_match_ratio,
+    const int find_homography_method,
+    const double find_homography_ransac_reproj_threshold,
+    const std::function<bool(
+        const cv::DMatch&,
+        const cv::DMatch&,
+        const float,
+        const cv::KeyPoint&,
+        const cv::KeyPoint&,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& is_good_match,
+    const std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& filter_good_matches,
+    const bool compact_model_descriptors,
+    const int model_descriptor_pca_components,
+    const std::function<cv::Mat(
+        const std::vector<cv::Point2f>&,
+        const std::vector<cv::Point2f>&,
+        const std::vector<float>&,
+        const mr::EstimatorParams&,
+        std::vector<unsigned char>&
+    )>& estimate_homography,
+    const mr::EstimatorParams& estimator_params
+)
+{
+    if (model_image.empty())
+        throw std::runtime_error("Input Model Image is empty");
+    
+    results.clear();
+    results.resize(user_images.size());
+    if (user_images.empty())
+        return;
+    
+    // compute model keypoints & descriptors only once,
+    // they are shared by all the workers as read-only data
+    mr::ModelFeatures model;
+    {
+        cv::Ptr<cv::Feature2D> f2d_detector;
+        mr::create_f2d_detector(algorithm, f2d_detector);
+        mr::extract_model_features(
+            model_image, f2d_detector, model,
+            compact_model_descriptors, model_descriptor_pca_components
+        );
+    }
+    
+    // each worker takes next user image index until all images are done
+    std::atomic<size_t> next_index(0);
+    auto worker = [&]()
+    {
+        cv::Ptr<cv::Feature2D> f2d_detector;
+        mr::create_f2d_detector(algorithm, f2d_detector);
+        mr::MatchBatch match_batch;
+        
+        for (size_t idx = next_index++; idx < user_images.size(); idx = next_index++)
+        {
+            mr::RegistrationResult& result = results[idx];
+            try
+            {
+                const cv::Mat& user_image = user_images[idx];
+                std::vector<cv::KeyPoint> user_keypoints;
+                cv::Mat user_descriptors;
+                mr::extract_user_features(user_image, f2d_detector, user_keypoints, user_descriptors);
+                mr::register_with_model_features(
+                    model, user_image, user_keypoints, user_descriptors, match_batch, result,
+                    layer_image, layer_image_transparency, filter_px,
+                    knn_k, good_match_ratio,
+                    find_homography_method, find_homography_ransac_reproj_threshold,
+                    is_good_match, filter_good_matches,
+                    estimate_homography, estimator_params
+                );
+            }
+            catch (const std::exception& error)
+            {
+                result.success = false;
+                result.error_message = error.what();
+            }
+        }
+    };
+    
+    // current thread also works as a worker
+    int thread_count = num_threads;
+    if (thread_count <= 0)
+        thread_count = static_cast<int>(std::thread::hardware_concurrency());
+    thread_count = mr::clamp<int>(thread_count, 1, static_cast<int>(user_images.size()));
+    
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (int i = 0; i < thread_count - 1; ++i)
+    {
+        try
+        {
+            threads.emplace_back(worker);
+        }
+        catch (const std::system_error&)
+        {
+            // cannot create more threads (e.g. platform without thread support),
+            // continue with threads we already have
+            break;
+        }
+    }
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+}
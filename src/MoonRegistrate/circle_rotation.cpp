@@ -0,0 +1,115 @@
+#include <opencv2/imgproc.hpp>
+
+#include <exception>
+#include <cmath>
+
+#include "MoonRegistration/MoonRegistrate/circle_rotation.hpp"
+
+
+namespace mr
+{
+
+// helper function for register_by_circles()
+// unwrap moon disk into a polar image, one row per ring (radius) and one column per angle,
+// every ring is normalized to zero mean
+static void circle_rotation_unwrap(
+    const cv::Mat& image_in,
+    const mr::Circle& circle,
+    const int canonical_radius,
+    const int angle_steps,
+    const float radius_ratio,
+    cv::Mat& rings_out
+)
+{
+    cv::Mat gray;
+    if (image_in.channels() == 3)
+        cv::cvtColor(image_in, gray, cv::COLOR_BGR2GRAY);
+    else if (image_in.channels() == 4)
+        cv::cvtColor(image_in, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = image_in;
+    
+    // cv::warpPolar() output has one row per angle and one column per radius
+    cv::Mat polar;
+    cv::warpPolar(
+        gray, polar,
+        cv::Size(canonical_radius, angle_steps),
+        cv::Point2f(static_cast<float>(circle.x), static_cast<float>(circle.y)),
+        circle.radius * radius_ratio,
+        cv::INTER_LINEAR | cv::WARP_FILL_OUTLIERS | cv::WARP_POLAR_LINEAR
+    );
+    cv::transpose(polar, polar);
+    polar.convertTo(rings_out, CV_32F);
+    
+    for (int r = 0; r < rings_out.rows; ++r)
+    {
+        cv::Mat ring = rings_out.row(r);
+        ring -= cv::mean(ring);
+    }
+}
+
+EXPORT_SYMBOL double register_by_circles(
+    const cv::Mat& user_image,
+    const mr::Circle& user_circle,
+    const cv::Mat& model_image,
+    const mr::Circle& model_circle,
+    cv::Mat& homography_out,
+    const int canonical_radius,
+    const int angle_steps,
+    const float radius_ratio
+)
+{
+    if (user_image.empty() || model_image.empty())
+        throw std::runtime_error("Empty user_image or model_image");
+    if (!mr::is_valid_circle(user_circle) || !mr::is_valid_circle(model_circle) ||
+        user_circle.radius <= 0 || model_circle.radius <= 0)
+        throw std::runtime_error("Invalid user_circle or model_circle");
+    if (canonical_radius <= 0 || angle_steps <= 0)
+        throw std::runtime_error("Invalid canonical_radius or angle_steps");
+    
+    cv::Mat user_rings, model_rings;
+    circle_rotation_unwrap(user_image, user_circle, canonical_radius, angle_steps, radius_ratio, user_rings);
+    circle_rotation_unwrap(model_image, model_circle, canonical_radius, angle_steps, radius_ratio, model_rings);
+    
+    // If model is user rotated by angle, model ring(theta) = user ring(theta - angle).
+    // So circular cross-correlation sum(user(theta) * model(theta + k)) peaks at k = angle.
+    // Compute it for every ring at once with a row-wise DFT, and sum spectrums of all the rings.
+    cv::Mat user_spectrum, model_spectrum, cross_spectrum;
+    cv::dft(user_rings, user_spectrum, cv::DFT_ROWS);
+    cv::dft(model_rings, model_spectrum, cv::DFT_ROWS);
+    cv::mulSpectrums(model_spectrum, user_spectrum, cross_spectrum, cv::DFT_ROWS, true);
+    cv::Mat cross_spectrum_sum, correlation;
+    cv::reduce(cross_spectrum, cross_spectrum_sum, 0, cv::REDUCE_SUM, CV_32F);
+    cv::idft(cross_spectrum_sum, correlation, cv::DFT_REAL_OUTPUT | cv::DFT_SCALE);
+    
+    // find peak, and refine it with a parabola through its neighbors
+    cv::Point peak_location;
+    double peak_value;
+    cv::minMaxLoc(correlation, NULL, &peak_value, NULL, &peak_location);
+    int k = peak_location.x;
+    const float* corr = correlation.ptr<float>(0);
+    double left = corr[(k - 1 + angle_steps) % angle_steps];
+    double right = corr[(k + 1) % angle_steps];
+    double denominator = left - 2.0 * peak_value + right;
+    double offset = (std::fabs(denominator) > 1e-12) ? (0.5 * (left - right) / denominator) : 0.0;
+    double angle = (k + offset) * 2.0 * CV_PI / static_cast<double>(angle_steps);
+    
+    double energy = std::sqrt(user_rings.dot(user_rings) * model_rings.dot(model_rings));
+    double score = (energy > 0.0) ? (peak_value / energy) : 0.0;
+    
+    // p_model = model_center + scale * R(angle) * (p_user - user_center)
+    double scale = static_cast<double>(model_circle.radius) / static_cast<double>(user_circle.radius);
+    double a = scale * std::cos(angle);
+    double b = scale * std::sin(angle);
+    double ux = static_cast<double>(user_circle.x);
+    double uy = static_cast<double>(user_circle.y);
+    cv::Matx33d homography(
+        a, -b, model_circle.x - a * ux + b * uy,
+        b, a, model_circle.y - b * ux - a * uy,
+        0.0, 0.0, 1.0
+    );
+    homography_out = cv::Mat(homography);
+    return score;
+}
+
+}
@@ -47,8 +47,52 @@ EXPORT_SYMBOL bool default_is_good_match_all(
     return (
         mr::filter_by_ignore_edge_kp(user_kpt, model_kpt, user_image, model_image, 0.9f) &&
         mr::filter_by_lowes_ratio_test(m, n, 0.85f) &&
-        mr::filter_by_ignore_close_kp(user_kpt, model_kpt, user_image, model_image, 0.03f)
+        mr::filter_by_ignore_close_kp(user_kpt, model_kpt, user_image, model_image, 0.03f, false)
     );
 }
 
+EXPORT_SYMBOL void default_filter_good_matches(
+    mr::MatchBatch& batch,
+    const float good_match_ratio,
+    const cv::Mat& user_image,
+    const cv::Mat& model_image
+)
+{
+    mr::filter_by_lowes_ratio_test(batch, 0.85f);
+    mr::filter_by_ignore_edge_kp(batch, user_image.size(), model_image.size(), 0.9f);
+}
+
+EXPORT_SYMBOL void default_filter_good_matches_lowes_ratio_only(
+    mr::MatchBatch& batch,
+    const float good_match_ratio,
+    const cv::Mat& user_image,
+    const cv::Mat& model_image
+)
+{
+    mr::filter_by_lowes_ratio_test(batch, good_match_ratio);
+}
+
+EXPORT_SYMBOL void default_filter_good_matches_all(
+    mr::MatchBatch& batch,
+    const float good_match_ratio,
+    const cv::Mat& user_image,
+    const cv::Mat& model_image
+)
+{
+    mr::filter_by_lowes_ratio_test(batch, 0.85f);
+    mr::filter_by_ignore_edge_kp(batch, user_image.size(), model_image.size(), 0.9f);
+    mr::filter_by_ignore_close_kp(batch, user_image.size(), model_image.size(), 0.03f);
+}
+
+EXPORT_SYMBOL cv::Mat default_estimate_homography(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const std::vector<float>& match_distances,
+    const mr::EstimatorParams& params,
+    std::vector<unsigned char>& inlier_mask
+)
+{
+    return mr::estimate_homography(user_pts, model_pts, params, inlier_mask);
+}
+
 }
@@ -0,0 +1,114 @@
+#include <opencv2/features2d.hpp>
+
+#include <exception>
+
+#include "MoonRegistration/MoonRegistrate/descriptors.hpp"
+
+
+namespace mr
+{
+
+EXPORT_SYMBOL CompactDescriptors::CompactDescriptors()
+{
+}
+
+EXPORT_SYMBOL CompactDescriptors::CompactDescriptors(const cv::Mat& descriptors, const int pca_components)
+{
+    this->compress(descriptors, pca_components);
+}
+
+EXPORT_SYMBOL void CompactDescriptors::compress(const cv::Mat& descriptors, const int pca_components)
+{
+    if (descriptors.empty())
+        throw std::runtime_error("Empty descriptors");
+    if (descriptors.channels() != 1 || (descriptors.depth() != CV_32F && descriptors.depth() != CV_8U))
+        throw std::runtime_error("Unsupported descriptors type, only CV_32F and CV_8U are supported");
+    
+    this->descriptor_type = descriptors.type();
+    this->descriptor_cols = descriptors.cols;
+    this->original_bytes = descriptors.total() * descriptors.elemSize();
+    this->pca = cv::PCA();
+    this->pca_components = -1;
+    this->scale = 1.0;
+    this->offset = 0.0;
+    
+    // binary descriptors, already compact
+    if (descriptors.depth() == CV_8U)
+    {
+        this->norm_type = cv::NORM_HAMMING;
+        descriptors.copyTo(this->data);
+        return;
+    }
+    
+    this->norm_type = cv::NORM_L2;
+    cv::Mat reduced = descriptors;
+    if (pca_components > 0 && pca_components < descriptors.cols && descriptors.rows > 1)
+    {
+        this->pca = cv::PCA(descriptors, cv::noArray(), cv::PCA::DATA_AS_ROW, pca_components);
+        this->pca_components = this->pca.eigenvectors.rows;
+        reduced = this->pca.project(descriptors);
+    }
+    
+    // one global scale for all the dimensions, so distances stay proportional
+    double min_value = 0.0, max_value = 0.0;
+    cv::minMaxLoc(reduced, &min_value, &max_value);
+    double range = max_value - min_value;
+    this->scale = (range > 0.0) ? (255.0 / range) : 1.0;
+    this->offset = -min_value * this->scale;
+    reduced.convertTo(this->data, CV_8U, this->scale, this->offset);
+}
+
+EXPORT_SYMBOL void CompactDescriptors::encode(const cv::Mat& descriptors, cv::Mat& compact_out) const
+{
+    if (this->data.empty())
+        throw std::runtime_error("Empty CompactDescriptors");
+    if (descriptors.type() != this->descriptor_type || descriptors.cols != this->descriptor_cols)
+        throw std::runtime_error("Descriptors type doesn't match with CompactDescriptors");
+    
+    if (this->norm_type == cv::NORM_HAMMING)
+    {
+        compact_out = descriptors;
+        return;
+    }
+    
+    // values out of stored descriptors' range are saturated
+    if (this->pca_components > 0)
+        this->pca.project(descriptors).convertTo(compact_out, CV_8U, this->scale, this->offset);
+    else
+        descriptors.convertTo(compact_out, CV_8U, this->scale, this->offset);
+}
+
+EXPORT_SYMBOL void CompactDescriptors::knn_match(
+    const cv::Mat& query_descriptors,
+    std::vector<std::vector<cv::DMatch>>& matches,
+    const int knn_k
+) const
+{
+    cv::Mat compact_query;
+    this->encode(query_descriptors, compact_query);
+    
+    // cv::BFMatcher computes NORM_L2 of CV_8U descriptors directly
+    cv::BFMatcher bf_matcher(this->norm_type);
+    bf_matcher.knnMatch(compact_query, this->data, matches, knn_k);
+    
+    if (this->norm_type == cv::NORM_L2 && this->scale != 1.0)
+    {
+        float inv_scale = static_cast<float>(1.0 / this->scale);
+        for (auto& knn : matches)
+            for (auto& match : knn)
+                match.distance *= inv_scale;
+    }
+}
+
+EXPORT_SYMBOL size_t CompactDescriptors::size_in_bytes() const
+{
+    size_t bytes = this->data.total() * this->data.elemSize();
+    if (this->pca_components > 0)
+    {
+        bytes += this->pca.eigenvectors.total() * this->pca.eigenvectors.elemSize();
+        bytes += this->pca.mean.total() * this->pca.mean.elemSize();
+    }
+    return bytes;
+}
+
+}
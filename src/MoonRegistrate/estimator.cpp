@@ -0,0 +1,226 @@
+#include <opencv2/calib3d.hpp>
+
+#include <exception>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include "MoonRegistration/MoonRegistrate/estimator.hpp"
+
+
+namespace mr
+{
+
+EXPORT_SYMBOL int min_points_of_motion_model(const mr::MotionModel& motion_model)
+{
+    switch (motion_model)
+    {
+    case mr::MotionModel::SIMILARITY:
+        return 2;
+    case mr::MotionModel::AFFINE:
+        return 3;
+    case mr::MotionModel::HOMOGRAPHY:
+        return 4;
+    default:
+        throw std::runtime_error("Invalid MotionModel");
+    }
+}
+
+EXPORT_SYMBOL cv::Mat estimate_homography(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const mr::EstimatorParams& params,
+    std::vector<unsigned char>& inlier_mask
+)
+{
+    if (params.motion_model != mr::MotionModel::HOMOGRAPHY)
+    {
+        // cv::estimateAffine*() only support RANSAC & LMEDS
+        int method = (params.method == cv::LMEDS) ? cv::LMEDS : cv::RANSAC;
+        cv::Mat affine;
+        if (params.motion_model == mr::MotionModel::SIMILARITY)
+        {
+            affine = cv::estimateAffinePartial2D(
+                user_pts, model_pts, inlier_mask,
+                method, params.ransac_reproj_threshold,
+                static_cast<size_t>(params.max_iters), params.confidence
+            );
+        }
+        else if (params.motion_model == mr::MotionModel::AFFINE)
+        {
+            affine = cv::estimateAffine2D(
+                user_pts, model_pts, inlier_mask,
+                method, params.ransac_reproj_threshold,
+                static_cast<size_t>(params.max_iters), params.confidence
+            );
+        }
+        else
+            throw std::runtime_error("Invalid MotionModel");
+        if (affine.empty())
+            return cv::Mat();
+        
+        // expand 2x3 affine matrix to 3x3 homography matrix
+        cv::Mat homography = cv::Mat::eye(3, 3, CV_64F);
+        affine.convertTo(homography.rowRange(0, 2), CV_64F);
+        return homography;
+    }
+    
+    return cv::findHomography(
+        user_pts, model_pts,
+        params.method,
+        params.ransac_reproj_threshold,
+        inlier_mask,
+        params.max_iters,
+        params.confidence
+    );
+}
+
+// helper function for PROSAC estimators,
+// sort points by match distance and return the sorting order
+static void sort_points_by_distance(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const std::vector<float>& match_distances,
+    std::vector<cv::Point2f>& sorted_user_pts,
+    std::vector<cv::Point2f>& sorted_model_pts,
+    std::vector<int>& order
+)
+{
+    if (match_distances.size() != user_pts.size())
+        throw std::runtime_error("Number of match_distances doesn't match with number of points");
+    
+    order.resize(user_pts.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&match_distances](const int lhs, const int rhs) {
+        return match_distances[lhs] < match_distances[rhs];
+    });
+    
+    sorted_user_pts.resize(user_pts.size());
+    sorted_model_pts.resize(model_pts.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        sorted_user_pts[i] = user_pts[order[i]];
+        sorted_model_pts[i] = model_pts[order[i]];
+    }
+}
+
+// helper function for PROSAC estimators,
+// map inlier mask of sorted points back to input order
+static void unsort_inlier_mask(
+    const std::vector<unsigned char>& sorted_inlier_mask,
+    const std::vector<int>& order,
+    std::vector<unsigned char>& inlier_mask
+)
+{
+    inlier_mask.assign(order.size(), 0);
+    if (sorted_inlier_mask.size() != order.size())
+        return;
+    for (size_t i = 0; i < order.size(); ++i)
+        inlier_mask[order[i]] = sorted_inlier_mask[i];
+}
+
+EXPORT_SYMBOL cv::Mat estimate_homography_prosac(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const std::vector<float>& match_distances,
+    const mr::EstimatorParams& params,
+    std::vector<unsigned char>& inlier_mask
+)
+{
+    std::vector<cv::Point2f> sorted_user_pts, sorted_model_pts;
+    std::vector<int> order;
+    sort_points_by_distance(
+        user_pts, model_pts, match_distances,
+        sorted_user_pts, sorted_model_pts, order
+    );
+    
+    std::vector<unsigned char> sorted_inlier_mask;
+    cv::Mat homography;
+    if (params.motion_model != mr::MotionModel::HOMOGRAPHY)
+    {
+        homography = mr::estimate_homography(
+            sorted_user_pts, sorted_model_pts, params, sorted_inlier_mask
+        );
+    }
+    else
+    {
+#ifdef MR_HAVE_OPENCV_USAC
+        int method = cv::USAC_PROSAC;
+#else
+        int method = cv::RHO;
+#endif
+        homography = cv::findHomography(
+            sorted_user_pts, sorted_model_pts,
+            method,
+            params.ransac_reproj_threshold,
+            sorted_inlier_mask,
+            params.max_iters,
+            params.confidence
+        );
+    }
+    
+    unsort_inlier_mask(sorted_inlier_mask, order, inlier_mask);
+    return homography;
+}
+
+#ifdef MR_HAVE_OPENCV_USAC
+
+EXPORT_SYMBOL cv::Mat estimate_homography_usac(
+    const std::vector<cv::Point2f>& user_pts,
+    const std::vector<cv::Point2f>& model_pts,
+    const std::vector<float>& match_distances,
+    const mr::EstimatorParams& params,
+    std::vector<unsigned char>& inlier_mask
+)
+{
+    std::vector<cv::Point2f> sorted_user_pts, sorted_model_pts;
+    std::vector<int> order;
+    sort_points_by_distance(
+        user_pts, model_pts, match_distances,
+        sorted_user_pts, sorted_model_pts, order
+    );
+    
+    cv::UsacParams usac_params;
+    usac_params.confidence = params.confidence;
+    usac_params.maxIterations = params.max_iters;
+    usac_params.threshold = params.ransac_reproj_threshold;
+    usac_params.sampler = cv::SAMPLING_PROSAC;
+    usac_params.score = cv::SCORE_METHOD_MAGSAC;
+    usac_params.loMethod = cv::LOCAL_OPTIM_SIGMA;
+    usac_params.loIterations = 10;
+    usac_params.loSampleSize = 14;
+    usac_params.neighborsSearch = cv::NEIGH_GRID;
+    usac_params.isParallel = false;
+    
+    std::vector<unsigned char> sorted_inlier_mask;
+    cv::Mat homography;
+    if (params.motion_model != mr::MotionModel::HOMOGRAPHY)
+    {
+        homography = mr::estimate_homography(
+            sorted_user_pts, sorted_model_pts, params, sorted_inlier_mask
+        );
+    }
+    else
+    {
+        homography = cv::findHomography(
+            sorted_user_pts, sorted_model_pts,
+            sorted_inlier_mask,
+            usac_params
+        );
+    }
+    
+    unsort_inlier_mask(sorted_inlier_mask, order, inlier_mask);
+    return homography;
+}
+
+#endif
+
+EXPORT_SYMBOL int count_inliers(const std::vector<unsigned char>& inlier_mask)
+{
+    int count = 0;
+    for (const unsigned char flag : inlier_mask)
+        count += (flag ? 1 : 0);
+    return count;
+}
+
+}
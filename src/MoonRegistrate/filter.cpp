@@ -1,7 +1,10 @@
 #include <opencv2/core.hpp>
 
 #include <vector>
-#include <unordered_map>
+#include <exception>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
 
 #include "MoonRegistration/MoonRegistrate/filter.hpp"
 #include "MoonRegistration/utils.hpp"
@@ -10,6 +13,80 @@
 namespace mr
 {
 
+EXPORT_SYMBOL void MatchBatch::assign(
+    const std::vector<std::vector<cv::DMatch>>& matches,
+    const std::vector<cv::KeyPoint>& user_keypoints,
+    const std::vector<cv::KeyPoint>& model_keypoints
+)
+{
+    // count matches with at least one element first,
+    // so every array is resized exactly once
+    size_t size = 0;
+    for (const auto& mn : matches)
+        size += (mn.empty() ? 0 : 1);
+    
+    this->m_distance.resize(size);
+    this->query_idx.resize(size);
+    this->train_idx.resize(size);
+    this->n_distance.resize(size);
+    this->user_pts.resize(size);
+    this->model_pts.resize(size);
+    this->mask.assign(size, 1);
+    
+    size_t i = 0;
+    for (const auto& mn : matches)
+    {
+        if (mn.empty())
+            continue;
+        const cv::DMatch& m = mn[0];
+        this->m_distance[i] = m.distance;
+        this->query_idx[i] = m.queryIdx;
+        this->train_idx[i] = m.trainIdx;
+        this->n_distance[i] = (mn.size() > 1) ? mn[1].distance : FLT_MAX;
+        this->user_pts[i] = user_keypoints[m.queryIdx].pt;
+        this->model_pts[i] = model_keypoints[m.trainIdx].pt;
+        ++i;
+    }
+}
+
+EXPORT_SYMBOL size_t MatchBatch::size() const
+{
+    return this->mask.size();
+}
+
+EXPORT_SYMBOL size_t MatchBatch::count() const
+{
+    size_t count = 0;
+    for (const unsigned char flag : this->mask)
+        count += flag;
+    return count;
+}
+
+EXPORT_SYMBOL void MatchBatch::collect(
+    std::vector<cv::DMatch>& good_matches,
+    std::vector<cv::Point2f>& user_pts,
+    std::vector<cv::Point2f>& model_pts
+) const
+{
+    size_t count = this->count();
+    good_matches.clear();
+    good_matches.reserve(count);
+    user_pts.clear();
+    user_pts.reserve(count);
+    model_pts.clear();
+    model_pts.reserve(count);
+    
+    for (size_t i = 0; i < this->mask.size(); ++i)
+    {
+        if (!this->mask[i])
+            continue;
+        good_matches.push_back(cv::DMatch(this->query_idx[i], this->train_idx[i], this->m_distance[i]));
+        user_pts.push_back(this->user_pts[i]);
+        model_pts.push_back(this->model_pts[i]);
+    }
+}
+
+
 EXPORT_SYMBOL bool filter_by_lowes_ratio_test(
     const cv::DMatch& m,
     const cv::DMatch& n,
@@ -36,12 +113,12 @@ EXPORT_SYMBOL bool filter_by_ignore_edge_kp(
     cv::Size user_size = user_image.size();
     double user_radius_guess = (user_size.width / 2.0f) * radius_guess_ratio;
     cv::Point2f user_center_pt((user_size.width / 2.0f), (user_size.height / 2.0f));
-    double user_distance = mr::norm_ptf(user_kpt.pt, user_center_pt, cv::NORM_L2);
+    double user_distance = std::hypot(user_kpt.pt.x - user_center_pt.x, user_kpt.pt.y - user_center_pt.y);
     
     cv::Size model_size = model_image.size();
     double model_radius_guess = (model_size.width / 2.0f) * radius_guess_ratio;
     cv::Point2f model_center_pt((model_size.width / 2.0f), (model_size.height / 2.0f));
-    double model_distance = mr::norm_ptf(model_kpt.pt, model_center_pt, cv::NORM_L2);
+    double model_distance = std::hypot(model_kpt.pt.x - model_center_pt.x, model_kpt.pt.y - model_center_pt.y);
     
     // Finally, ignore all the keypoints outside of image circle that we guess
     return (
@@ -51,81 +128,164 @@ EXPORT_SYMBOL bool filter_by_ignore_edge_kp(
 }
 
 
-struct KeyPointHolder
+namespace
 {
-    cv::KeyPoint user;
-    cv::KeyPoint model;
+
+// helper class for filter_by_ignore_close_kp()
+// 
+// A flat grid-bucketed spatial hash.
+// We can "hash" a 2d point by integer divide it by a value
+// e.g. if we have point a(1, 2), b(2, 3), c(11, 12)
+// we can divide all of them by 10 and get:
+// a(0, 0), b(0, 0), c(1, 1)
+// 
+// After division, we "blur" these points, and now point a & b are on
+// same location, which is a cell of the grid.
+// Points who are close to each other fall into the same cell.
+// 
+// Each cell only remembers how many points fell in it and index of its first two points,
+// that's all we need to check a new point, so the grid never grows after reset().
+struct CloseKpGrid
+{
+    int cols = 0;
+    int rows = 0;
+    float cell_width = 1.0f;
+    float cell_height = 1.0f;
+    std::vector<int> count;
+    std::vector<int> first;
+    std::vector<int> second;
+    
+    void reset(const cv::Size& image_size, const float hash_coordinate_ratio)
+    {
+        // determine the constant for integer division using image width & height
+        this->cell_width = std::max(image_size.width * hash_coordinate_ratio, 1.0f);
+        this->cell_height = std::max(image_size.height * hash_coordinate_ratio, 1.0f);
+        this->cols = static_cast<int>(image_size.width / this->cell_width) + 1;
+        this->rows = static_cast<int>(image_size.height / this->cell_height) + 1;
+        size_t cell_num = static_cast<size_t>(this->cols) * static_cast<size_t>(this->rows);
+        this->count.assign(cell_num, 0);
+        this->first.resize(cell_num);
+        this->second.resize(cell_num);
+    }
+    
+    int cell(const cv::Point2f& pt) const
+    {
+        int x = mr::clamp<int>(static_cast<int>(pt.x / this->cell_width), 0, this->cols - 1);
+        int y = mr::clamp<int>(static_cast<int>(pt.y / this->cell_height), 0, this->rows - 1);
+        return (y * this->cols + x);
+    }
+    
+    // insert point index into its cell, return number of points in that cell
+    int insert(const int cell, const int index)
+    {
+        int n = ++this->count[cell];
+        if (n == 1)
+            this->first[cell] = index;
+        else if (n == 2)
+            this->second[cell] = index;
+        return n;
+    }
 };
-std::unordered_map<int,std::vector<KeyPointHolder>> user_filter_table;
-std::unordered_map<int,std::vector<KeyPointHolder>> model_filter_table;
-// helper function for filter_by_ignore_close_kp()
-int ignore_close_kp_hash_coordinate(
-    const cv::KeyPoint& kpt,
-    const cv::Mat& image,
-    float hash_coordinate_ratio
-)
+
+// per-registration state of filter_by_ignore_close_kp()
+struct CloseKpFilter
 {
-    // we can "hash" a 2d point by integer divide it by a value
-    // e.g. if we have point a(1, 2), b(2, 3), c(11, 12)
-    // we can divide all of them by 10 and get:
-    // a(0, 0), b(0, 0), c(1, 1)
-    // 
-    // After division, we "blur" these points, and now point a & b are on
-    // same location.
-    // Finally, we can "hash" these points by converting them to 1d point.
-    // We can use this algorithm to "blur" points, and points who are close
-    // to each other will have them same coordinate after "blur", the final
-    // 1d coordinate is our "hash sum".
-    
-    float x = kpt.pt.x;
-    float y = kpt.pt.y;
-    // determine the constant for integer division using image width & height
-    float x_ratio = image.size().width * hash_coordinate_ratio;
-    float y_ratio = image.size().height * hash_coordinate_ratio;
-    int new_x = static_cast<int>(x / x_ratio);
-    int new_y = static_cast<int>(y / y_ratio);
-    int w = static_cast<int>(image.size().width / x_ratio);
-    int h = static_cast<int>(image.size().height / y_ratio);
-    return (w * (new_y - 1) + new_x);
+    CloseKpGrid user_grid;
+    CloseKpGrid model_grid;
+    std::vector<cv::Point2f> user_pts;
+    std::vector<cv::Point2f> model_pts;
+    
+    void reset(
+        const cv::Size& user_size,
+        const cv::Size& model_size,
+        const float hash_coordinate_ratio,
+        const size_t reserve_size = 0
+    )
+    {
+        this->user_grid.reset(user_size, hash_coordinate_ratio);
+        this->model_grid.reset(model_size, hash_coordinate_ratio);
+        this->user_pts.clear();
+        this->model_pts.clear();
+        this->user_pts.reserve(reserve_size);
+        this->model_pts.reserve(reserve_size);
+    }
+    
+    static double distance(const cv::Point2f& a, const cv::Point2f& b)
+    {
+        double dx = static_cast<double>(a.x) - static_cast<double>(b.x);
+        double dy = static_cast<double>(a.y) - static_cast<double>(b.y);
+        return std::sqrt(dx * dx + dy * dy);
+    }
+    
+    // check whether point comp is consistent with first two points (src & dst) in its cell
+    bool check_cell(const CloseKpGrid& grid, const int cell, const int comp) const
+    {
+        int src = grid.first[cell];
+        int dst = grid.second[cell];
+        
+        // We first use keypoints src and dst to calculate a ratio of euclidean distance.
+        // So we get: ratio1 = distance(src.user, dst.user) / distance(src.model, dst.model)
+        // If keypoint comp isn't really close to src & dst, then the distance ratio of
+        // comp with src & dst should have a significant difference.
+        // That is: ratio2 = distance(src.user, comp.user) / distance(src.model, comp.model)
+        // ratio1 and ratio2 should have a significant difference.
+        // We can do the same thing with ratio3,
+        // ratio3 = distance(dst.user, comp.user) / distance(dst.model, comp.model)
+        // ratio3 and ratio 2 should have a significant difference.
+        
+        const double model_dist = distance(this->model_pts[src], this->model_pts[dst]);
+        const double model_src_comp_dist = distance(this->model_pts[src], this->model_pts[comp]);
+        const double model_dst_comp_dist = distance(this->model_pts[dst], this->model_pts[comp]);
+        
+        // many-to-one matches put different user keypoints on the same model keypoint,
+        // ratio is undefined (x / 0), treat them as not consistent
+        if (model_dist <= 0.0 || model_src_comp_dist <= 0.0 || model_dst_comp_dist <= 0.0)
+            return false;
+        
+        double dist_ratio = distance(this->user_pts[src], this->user_pts[dst]) / model_dist;
+        double src_comp_dist_ratio = distance(this->user_pts[src], this->user_pts[comp]) / model_src_comp_dist;
+        double dst_comp_dist_ratio = distance(this->user_pts[dst], this->user_pts[comp]) / model_dst_comp_dist;
+        
+        return (
+            (std::fabs(dist_ratio - src_comp_dist_ratio) <= 0.1) &&
+            (std::fabs(dist_ratio - dst_comp_dist_ratio) <= 0.1)
+        );
+    }
+    
+    // insert a pair of keypoints and check them
+    bool insert(const cv::Point2f& user_pt, const cv::Point2f& model_pt)
+    {
+        int index = static_cast<int>(this->user_pts.size());
+        this->user_pts.push_back(user_pt);
+        this->model_pts.push_back(model_pt);
+        
+        // insert user keypoints into user grid
+        int user_cell = this->user_grid.cell(user_pt);
+        if (this->user_grid.insert(user_cell, index) >= 3)
+            return this->check_cell(this->user_grid, user_cell, index);
+        
+        // insert model keypoints into model grid
+        int model_cell = this->model_grid.cell(model_pt);
+        if (this->model_grid.insert(model_cell, index) >= 3)
+            return this->check_cell(this->model_grid, model_cell, index);
+        
+        return true;
+    }
+};
+
+// state of single match version of filter_by_ignore_close_kp(),
+// it lives across calls, so each thread gets its own copy
+thread_local CloseKpFilter close_kp_filter_state;
+// set by reset_filter_by_ignore_close_kp(), next call cleans up the state
+thread_local bool close_kp_filter_state_stale = true;
 
 }
-bool ignore_close_kp_handle_table_dup(
-    std::unordered_map<int,std::vector<KeyPointHolder>>& table,
-    const int hash
-)
+
+EXPORT_SYMBOL void reset_filter_by_ignore_close_kp()
 {
-    // randomly sample 3 elements out of table[hash]
-    // make src = tmp[0], dst = tmp[1], comp = tmp[2]
-    std::vector<KeyPointHolder> tmp;
-    mr::sample_vector(3, table[hash], tmp);
-    
-    // We first use keypoints src and dst to calculate a ratio of euclidean distance.
-    // So we get: ratio1 = distance(src.user, dst.user) / distance(src.model, dst.model)
-    // If keypoint comp isn't really close to src & dst, then the distance ratio of
-    // comp with src & dst should have a significant difference.
-    // That is: ratio2 = distance(src.user, comp.user) / distance(src.model, comp.model)
-    // ratio1 and ratio2 should have a significant difference.
-    // We can do the same thing with ratio3,
-    // ratio3 = distance(dst.user, comp.user) / distance(dst.model, comp.model)
-    // ratio3 and ratio 2 should have a significant difference.
-    
-    double user_dist = mr::norm_kp(tmp[0].user, tmp[1].user, cv::NORM_L2);
-    double model_dist = mr::norm_kp(tmp[0].model, tmp[1].model, cv::NORM_L2);
-    double dist_ratio = user_dist / model_dist;
-    
-    double src_comp_user_dist = mr::norm_kp(tmp[0].user, tmp[2].user, cv::NORM_L2);
-    double src_comp_model_dist = mr::norm_kp(tmp[0].model, tmp[2].model, cv::NORM_L2);
-    double src_comp_dist_ratio = src_comp_user_dist / src_comp_model_dist;
-    
-    double dst_comp_user_dist = mr::norm_kp(tmp[1].user, tmp[2].user, cv::NORM_L2);
-    double dst_comp_model_dist = mr::norm_kp(tmp[1].model, tmp[2].model, cv::NORM_L2);
-    double dst_comp_dist_ratio = dst_comp_user_dist / dst_comp_model_dist;
-    
-    return (
-        (fabs(dist_ratio - src_comp_dist_ratio) <= 0.1) &&
-        (fabs(dist_ratio - dst_comp_dist_ratio) <= 0.1)
-    );
+    close_kp_filter_state_stale = true;
 }
+
 EXPORT_SYMBOL bool filter_by_ignore_close_kp(
     const cv::KeyPoint& user_kpt,
     const cv::KeyPoint& model_kpt,
@@ -135,34 +295,159 @@ EXPORT_SYMBOL bool filter_by_ignore_close_kp(
     const bool is_first_time
 )
 {
-    if (is_first_time)
+    if (is_first_time || close_kp_filter_state_stale)
     {
-        user_filter_table.clear();
-        model_filter_table.clear();
+        close_kp_filter_state.reset(
+            user_image.size(), model_image.size(),
+            hash_coordinate_ratio
+        );
+        close_kp_filter_state_stale = false;
     }
     
-    // hash coordinate
-    int user_hash = ignore_close_kp_hash_coordinate(
-        user_kpt, user_image, hash_coordinate_ratio
-    );
-    int model_hash = ignore_close_kp_hash_coordinate(
-        model_kpt, model_image, hash_coordinate_ratio
-    );
+    return close_kp_filter_state.insert(user_kpt.pt, model_kpt.pt);
+}
+
+// batch filter functions
+
+EXPORT_SYMBOL void filter_by_lowes_ratio_test(
+    mr::MatchBatch& batch,
+    const float ratio
+)
+{
+    // branchless loop over flat arrays, compiler can vectorize it
+    const size_t size = batch.size();
+    const float* m_distance = batch.m_distance.data();
+    const float* n_distance = batch.n_distance.data();
+    unsigned char* mask = batch.mask.data();
+    for (size_t i = 0; i < size; ++i)
+        mask[i] &= static_cast<unsigned char>(m_distance[i] < ratio * n_distance[i]);
+}
+
+EXPORT_SYMBOL void filter_by_ignore_edge_kp(
+    mr::MatchBatch& batch,
+    const cv::Size& user_size,
+    const cv::Size& model_size,
+    const float radius_guess_ratio
+)
+{
+    // same guess as single match version,
+    // but compare squared distances so we don't need sqrt
+    const float user_radius_guess = (user_size.width / 2.0f) * radius_guess_ratio;
+    const float user_radius_guess_sq = user_radius_guess * user_radius_guess;
+    const float user_cx = user_size.width / 2.0f;
+    const float user_cy = user_size.height / 2.0f;
     
-    // insert user keypoints into user table
-    KeyPointHolder holder = {user_kpt, model_kpt};
-    bool user_hash_exist = (user_filter_table.find(user_hash) == user_filter_table.end());
-    user_filter_table[user_hash].push_back(holder);
-    if (user_hash_exist && user_filter_table[user_hash].size() >= 3)
-        return ignore_close_kp_handle_table_dup(user_filter_table, user_hash);
+    const float model_radius_guess = (model_size.width / 2.0f) * radius_guess_ratio;
+    const float model_radius_guess_sq = model_radius_guess * model_radius_guess;
+    const float model_cx = model_size.width / 2.0f;
+    const float model_cy = model_size.height / 2.0f;
     
-    // insert model keypoints into model table
-    bool model_hash_exist = (model_filter_table.find(model_hash) == model_filter_table.end());
-    model_filter_table[model_hash].push_back(holder);
-    if (model_hash_exist && user_filter_table[model_hash].size() >= 3)
-        return ignore_close_kp_handle_table_dup(model_filter_table, model_hash);
+    const size_t size = batch.size();
+    const cv::Point2f* user_pts = batch.user_pts.data();
+    const cv::Point2f* model_pts = batch.model_pts.data();
+    unsigned char* mask = batch.mask.data();
+    for (size_t i = 0; i < size; ++i)
+    {
+        float udx = user_pts[i].x - user_cx;
+        float udy = user_pts[i].y - user_cy;
+        float mdx = model_pts[i].x - model_cx;
+        float mdy = model_pts[i].y - model_cy;
+        mask[i] &= static_cast<unsigned char>(
+            ((udx * udx + udy * udy) <= user_radius_guess_sq) &
+            ((mdx * mdx + mdy * mdy) <= model_radius_guess_sq)
+        );
+    }
+}
+
+EXPORT_SYMBOL void filter_by_ignore_close_kp(
+    mr::MatchBatch& batch,
+    const cv::Size& user_size,
+    const cv::Size& model_size,
+    const float hash_coordinate_ratio
+)
+{
+    // state is owned by this call, so it is safe to filter in multiple threads
+    CloseKpFilter filter;
+    filter.reset(user_size, model_size, hash_coordinate_ratio, batch.count());
     
-    return true;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        if (!batch.mask[i])
+            continue;
+        batch.mask[i] = static_cast<unsigned char>(
+            filter.insert(batch.user_pts[i], batch.model_pts[i])
+        );
+    }
+}
+
+
+EXPORT_SYMBOL void select_good_matches(
+    const std::vector<std::vector<cv::DMatch>>& matches,
+    const std::vector<cv::KeyPoint>& user_keypoints,
+    const std::vector<cv::KeyPoint>& model_keypoints,
+    const cv::Mat& user_image,
+    const cv::Mat& model_image,
+    const float good_match_ratio,
+    const std::function<bool(
+        const cv::DMatch&,
+        const cv::DMatch&,
+        const float,
+        const cv::KeyPoint&,
+        const cv::KeyPoint&,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& is_good_match,
+    const std::function<void(
+        mr::MatchBatch&,
+        const float,
+        const cv::Mat&,
+        const cv::Mat&
+    )>& filter_good_matches,
+    mr::MatchBatch& match_batch,
+    std::vector<cv::DMatch>& good_matches,
+    std::vector<cv::Point2f>& user_pts,
+    std::vector<cv::Point2f>& model_pts
+)
+{
+    good_matches.clear();
+    user_pts.clear();
+    model_pts.clear();
+    if (is_good_match)
+    {
+        // user defined single match filter, matches of this registration only
+        mr::reset_filter_by_ignore_close_kp();
+        for (const auto& mn : matches)
+        {
+            // knn_k = 1 or a single model descriptor gives less than 2 matches,
+            // use a FLT_MAX second match same as mr::MatchBatch::assign()
+            if (mn.empty())
+                continue;
+            const cv::DMatch second = (mn.size() > 1) ? mn[1] : cv::DMatch(mn[0].queryIdx, mn[0].trainIdx, FLT_MAX);
+            const cv::KeyPoint& user_kpt = user_keypoints[mn[0].queryIdx];
+            const cv::KeyPoint& model_kpt = model_keypoints[mn[0].trainIdx];
+            bool flag = is_good_match(
+                mn[0], second,
+                good_match_ratio,
+                user_kpt, model_kpt,
+                user_image, model_image
+            );
+            if (flag)
+            {
+                good_matches.push_back(mn[0]);
+                user_pts.push_back(user_kpt.pt);
+                model_pts.push_back(model_kpt.pt);
+            }
+        }
+    }
+    else
+    {
+        // batch filter over all the matches at once
+        if (!filter_good_matches)
+            throw std::runtime_error("Empty filter_good_matches and is_good_match");
+        match_batch.assign(matches, user_keypoints, model_keypoints);
+        filter_good_matches(match_batch, good_match_ratio, user_image, model_image);
+        match_batch.collect(good_matches, user_pts, model_pts);
+    }
 }
 
 };
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include <opencv2/imgproc.hpp>
+
+#include <exception>
+#include <algorithm>
+#include <cmath>
+
+#include "MoonRegistration/MoonRegistrate/fourier_mellin.hpp"
+
+
+namespace mr
+{
+
+// helper function for register_fourier_mellin()
+// place gray image_in at the center of a canvas_size x canvas_size float canvas,
+// output transform_out maps image_in coordinate to canvas coordinate
+static void fourier_mellin_make_canvas(
+    const cv::Mat& image_in,
+    const int canvas_size,
+    cv::Mat& canvas_out,
+    cv::Matx33d& transform_out
+)
+{
+    cv::Mat gray;
+    if (image_in.channels() == 3)
+        cv::cvtColor(image_in, gray, cv::COLOR_BGR2GRAY);
+    else if (image_in.channels() == 4)
+        cv::cvtColor(image_in, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = image_in;
+    
+    double ratio = (
+        static_cast<double>(canvas_size) /
+        static_cast<double>(std::max(gray.cols, gray.rows))
+    );
+    cv::Size scaled_size(
+        std::max(1, std::min(canvas_size, static_cast<int>(std::round(gray.cols * ratio)))),
+        std::max(1, std::min(canvas_size, static_cast<int>(std::round(gray.rows * ratio))))
+    );
+    int offset_x = (canvas_size - scaled_size.width) / 2;
+    int offset_y = (canvas_size - scaled_size.height) / 2;
+    
+    cv::Mat scaled;
+    cv::resize(gray, scaled, scaled_size, 0, 0, cv::INTER_AREA);
+    canvas_out = cv::Mat::zeros(canvas_size, canvas_size, CV_32FC1);
+    cv::Mat canvas_roi = canvas_out(cv::Rect(offset_x, offset_y, scaled_size.width, scaled_size.height));
+    scaled.convertTo(canvas_roi, CV_32F);
+    
+    transform_out = cv::Matx33d(
+        static_cast<double>(scaled_size.width) / gray.cols, 0.0, static_cast<double>(offset_x),
+        0.0, static_cast<double>(scaled_size.height) / gray.rows, static_cast<double>(offset_y),
+        0.0, 0.0, 1.0
+    );
+}
+
+// helper function for register_fourier_mellin()
+// swap quadrants of a spectrum so zero frequency is at the center, image size must be even
+static void fourier_mellin_fftshift(cv::Mat& spectrum)
+{
+    int cx = spectrum.cols / 2;
+    int cy = spectrum.rows / 2;
+    cv::Mat q0(spectrum, cv::Rect(0, 0, cx, cy));
+    cv::Mat q1(spectrum, cv::Rect(cx, 0, cx, cy));
+    cv::Mat q2(spectrum, cv::Rect(0, cy, cx, cy));
+    cv::Mat q3(spectrum, cv::Rect(cx, cy, cx, cy));
+    
+    cv::Mat tmp;
+    q0.copyTo(tmp);
+    q3.copyTo(q0);
+    tmp.copyTo(q3);
+    q1.copyTo(tmp);
+    q2.copyTo(q1);
+    tmp.copyTo(q2);
+}
+
+// helper function for register_fourier_mellin()
+// high-pass emphasis filter for centered magnitude spectrum,
+// it suppresses low frequencies that dominate log-polar correlation
+static void fourier_mellin_highpass(const int canvas_size, cv::Mat& highpass_out)
+{
+    highpass_out.create(canvas_size, canvas_size, CV_32FC1);
+    for (int y = 0; y < canvas_size; ++y)
+    {
+        float* row = highpass_out.ptr<float>(y);
+        double eta = static_cast<double>(y - canvas_size / 2) / canvas_size;
+        for (int x = 0; x < canvas_size; ++x)
+        {
+            double xi = static_cast<double>(x - canvas_size / 2) / canvas_size;
+            double value = std::cos(CV_PI * xi) * std::cos(CV_PI * eta);
+            row[x] = static_cast<float>((1.0 - value) * (2.0 - value));
+        }
+    }
+}
+
+// helper function for register_fourier_mellin()
+// compute log-polar image of log magnitude spectrum of canvas,
+// rows of output cover 360 degrees, columns cover log radius
+static void fourier_mellin_log_polar_spectrum(
+    const cv::Mat& canvas,
+    const cv::Mat& window,
+    const cv::Mat& highpass,
+    cv::Mat& log_polar_out
+)
+{
+    cv::Mat spectrum;
+    cv::dft(canvas.mul(window), spectrum, cv::DFT_COMPLEX_OUTPUT);
+    
+    cv::Mat planes[2];
+    cv::split(spectrum, planes);
+    cv::Mat magnitude;
+    cv::magnitude(planes[0], planes[1], magnitude);
+    fourier_mellin_fftshift(magnitude);
+    magnitude = magnitude.mul(highpass);
+    magnitude += cv::Scalar::all(1.0);
+    cv::log(magnitude, magnitude);
+    
+    float half_size = static_cast<float>(canvas.cols / 2);
+    cv::warpPolar(
+        magnitude, log_polar_out,
+        canvas.size(),
+        cv::Point2f(half_size, half_size),
+        half_size,
+        cv::INTER_LINEAR | cv::WARP_FILL_OUTLIERS | cv::WARP_POLAR_LOG
+    );
+}
+
+EXPORT_SYMBOL double register_fourier_mellin(
+    const cv::Mat& user_image,
+    const cv::Mat& model_image,
+    cv::Mat& homography_out,
+    const int canvas_size
+)
+{
+    if (user_image.empty() || model_image.empty())
+        throw std::runtime_error("Empty user_image or model_image");
+    
+    // fftshift requires an even canvas size
+    const int size = std::max(canvas_size, 32) & ~1;
+    const double half_size = static_cast<double>(size / 2);
+    
+    cv::Mat user_canvas, model_canvas;
+    cv::Matx33d user_transform, model_transform;
+    fourier_mellin_make_canvas(user_image, size, user_canvas, user_transform);
+    fourier_mellin_make_canvas(model_image, size, model_canvas, model_transform);
+    
+    cv::Mat window, highpass;
+    cv::createHanningWindow(window, cv::Size(size, size), CV_32F);
+    fourier_mellin_highpass(size, highpass);
+    
+    // rotation & scale
+    // If model is user rotated by angle and scaled by scale, magnitude spectrum of model is
+    // the one of user rotated by angle and scaled by 1/scale. In log-polar space, they become
+    // a shift of (angle * size / 2pi) rows and (-log(scale) * klog) columns.
+    cv::Mat user_log_polar, model_log_polar;
+    fourier_mellin_log_polar_spectrum(user_canvas, window, highpass, user_log_polar);
+    fourier_mellin_log_polar_spectrum(model_canvas, window, highpass, model_log_polar);
+    cv::Point2d log_polar_shift = cv::phaseCorrelate(user_log_polar, model_log_polar);
+    
+    double klog = static_cast<double>(size) / std::log(half_size);
+    double angle = log_polar_shift.y * 2.0 * CV_PI / static_cast<double>(size);
+    double scale = std::exp(-log_polar_shift.x / klog);
+    
+    // translation
+    // magnitude spectrum is symmetric, so angle is ambiguous by 180 degrees.
+    // try both, and keep the one with higher translation phase correlation response
+    double best_response = -1.0;
+    cv::Matx33d best_transform = cv::Matx33d::eye();
+    cv::Mat warped_user_canvas;
+    for (const double candidate : {angle, angle + CV_PI})
+    {
+        double a = scale * std::cos(candidate);
+        double b = scale * std::sin(candidate);
+        // rotate & scale around canvas center
+        cv::Matx23d rotation_scale(
+            a, -b, half_size - a * half_size + b * half_size,
+            b, a, half_size - b * half_size - a * half_size
+        );
+        cv::warpAffine(user_canvas, warped_user_canvas, rotation_scale, user_canvas.size());
+        
+        double response = 0.0;
+        cv::Point2d shift = cv::phaseCorrelate(warped_user_canvas, model_canvas, window, &response);
+        if (response > best_response)
+        {
+            best_response = response;
+            best_transform = cv::Matx33d(
+                rotation_scale(0, 0), rotation_scale(0, 1), rotation_scale(0, 2) + shift.x,
+                rotation_scale(1, 0), rotation_scale(1, 1), rotation_scale(1, 2) + shift.y,
+                0.0, 0.0, 1.0
+            );
+        }
+    }
+    
+    // canvas coordinate back to image coordinate
+    homography_out = cv::Mat(model_transform.inv() * best_transform * user_transform);
+    return best_response;
+}
+
+}
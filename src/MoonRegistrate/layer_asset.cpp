@@ -0,0 +1,114 @@
+#include <opencv2/imgproc.hpp>
+
+#include <exception>
+#include <algorithm>
+#include <cmath>
+
+#include "MoonRegistration/MoonRegistrate/layer_asset.hpp"
+
+
+namespace mr
+{
+
+// pyramid stops before the shorter side of a level goes below this size
+const int LAYER_ASSET_MIN_LEVEL_SIZE = 16;
+
+EXPORT_SYMBOL LayerAsset::LayerAsset()
+{
+}
+
+EXPORT_SYMBOL LayerAsset::LayerAsset(const cv::Mat& layer_image, const int max_levels)
+{
+    this->update_layer_image(layer_image, max_levels);
+}
+
+EXPORT_SYMBOL void LayerAsset::update_layer_image(const cv::Mat& layer_image, const int max_levels)
+{
+    if (layer_image.empty())
+        throw std::runtime_error("Empty layer_image");
+    if (layer_image.depth() != CV_8U)
+        throw std::runtime_error("mr::LayerAsset only supports CV_8U layer_image");
+    
+    // BGRA, create alpha channel the same way as mr::draw_layer_image()
+    cv::Mat bgra;
+    if (layer_image.channels() == 4)
+        bgra = layer_image.clone();
+    else if (layer_image.channels() == 3 || layer_image.channels() == 1)
+    {
+        cv::Mat gray, alpha;
+        if (layer_image.channels() == 3)
+        {
+            cv::cvtColor(layer_image, gray, cv::COLOR_BGR2GRAY);
+            cv::cvtColor(layer_image, bgra, cv::COLOR_BGR2BGRA);
+        }
+        else
+        {
+            gray = layer_image;
+            cv::cvtColor(layer_image, bgra, cv::COLOR_GRAY2BGRA);
+        }
+        cv::threshold(gray, alpha, 0, 255, cv::THRESH_BINARY);
+        cv::insertChannel(alpha, bgra, 3);
+    }
+    else
+        throw std::runtime_error("Invalid number of channels");
+    
+    // premultiply color channels by alpha
+    for (int y = 0; y < bgra.rows; ++y)
+    {
+        cv::Vec4b* row = bgra.ptr<cv::Vec4b>(y);
+        for (int x = 0; x < bgra.cols; ++x)
+        {
+            const int alpha = row[x][3];
+            if (alpha == 255)
+                continue;
+            for (int c = 0; c < 3; ++c)
+                row[x][c] = static_cast<uchar>((row[x][c] * alpha + 127) / 255);
+        }
+    }
+    
+    // mip pyramid, averaging premultiplied pixels keeps transparent pixels from bleeding color
+    this->levels.clear();
+    this->levels.push_back(bgra);
+    while (max_levels <= 0 || static_cast<int>(this->levels.size()) < max_levels)
+    {
+        const cv::Mat& last = this->levels.back();
+        if (std::min(last.cols, last.rows) / 2 < LAYER_ASSET_MIN_LEVEL_SIZE)
+            break;
+        cv::Mat next;
+        cv::pyrDown(last, next);
+        this->levels.push_back(next);
+    }
+}
+
+EXPORT_SYMBOL int LayerAsset::select_level(const double footprint) const
+{
+    if (this->levels.empty())
+        throw std::runtime_error("Empty mr::LayerAsset");
+    if (!(footprint > 1.0))
+        return 0;
+    int level = static_cast<int>(std::floor(std::log2(footprint)));
+    return std::min(level, this->level_count() - 1);
+}
+
+EXPORT_SYMBOL cv::Matx33d LayerAsset::get_level_transform(const int level) const
+{
+    const cv::Mat& level_image = this->get_level(level);
+    
+    // pixel centers are aligned between levels
+    const double ratio_x = static_cast<double>(level_image.cols) / this->levels[0].cols;
+    const double ratio_y = static_cast<double>(level_image.rows) / this->levels[0].rows;
+    return cv::Matx33d(
+        ratio_x, 0.0, 0.5 * ratio_x - 0.5,
+        0.0, ratio_y, 0.5 * ratio_y - 0.5,
+        0.0, 0.0, 1.0
+    );
+}
+
+EXPORT_SYMBOL const cv::Mat& LayerAsset::get_level(const int level) const
+{
+    if (level < 0 || level >= this->level_count())
+        throw std::runtime_error("Invalid mr::LayerAsset level");
+    return this->levels[level];
+}
+
+}
@@ -0,0 +1,161 @@
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <exception>
+
+#include "MoonRegistration/MoonRegistrate/pipeline.hpp"
+#include "MoonRegistration/imgprocess.hpp"
+#include "MoonRegistration/utils.hpp"
+
+
+namespace mr
+{
+
+EXPORT_SYMBOL MoonRegistrationPipeline::MoonRegistrationPipeline()
+{
+}
+
+EXPORT_SYMBOL MoonRegistrationPipeline::MoonRegistrationPipeline(
+    const cv::Mat& model_image,
+    const mr::RegistrationAlgorithms& algorithm,
+    const cv::Mat& layer_image
+)
+{
+    mr::create_f2d_detector(algorithm, this->f2d_detector);
+    this->algorithm = algorithm;
+    this->update_model_image(model_image, layer_image);
+}
+
+
+EXPORT_SYMBOL void MoonRegistrationPipeline::update_model_image(const cv::Mat& model_image, const cv::Mat& layer_image)
+{
+    if (this->f2d_detector.empty())
+        throw std::runtime_error("Empty Feature2D detector");
+    mr::extract_model_features(model_image, this->f2d_detector, this->model);
+    this->layer_image = layer_image;
+}
+
+EXPORT_SYMBOL void MoonRegistrationPipeline::update_f2d_detector(const mr::RegistrationAlgorithms& algorithm)
+{
+    cv::Ptr<cv::Feature2D> f2d_detector;
+    mr::create_f2d_detector(algorithm, f2d_detector);
+    if (f2d_detector.empty())
+        throw std::runtime_error("mr::MoonRegistrationPipeline requires a Feature2D algorithm");
+    this->f2d_detector = f2d_detector;
+    this->algorithm = algorithm;
+    
+    // model features must come from the same algorithm
+    if (!this->model.image.empty())
+        mr::extract_model_features(this->model.image, this->f2d_detector, this->model);
+}
+
+EXPORT_SYMBOL void MoonRegistrationPipeline::update_crop_padding(const int crop_padding)
+{
+    this->crop_padding = crop_padding;
+}
+
+EXPORT_SYMBOL void MoonRegistrationPipeline::update_image(const std::string& image_filepath)
+{
+    if (!file_exists(image_filepath))
+        throw std::runtime_error("Empty Input Image");
+    this->update_image(cv::imread(image_filepath, cv::IMREAD_UNCHANGED));
+}
+
+EXPORT_SYMBOL void MoonRegistrationPipeline::update_image(const std::vector<unsigned char>& image_binary)
+{
+    this->update_image(cv::imdecode(cv::Mat(image_binary), cv::IMREAD_UNCHANGED));
+}
+
+EXPORT_SYMBOL void MoonRegistrationPipeline::update_image(const cv::Mat& image_in)
+{
+    if (image_in.empty())
+        throw std::runtime_error("Empty Input Image");
+    
+    // share image_in, and convert it to gray only once for all the stages
+    this->image = image_in;
+    if (this->image.channels() == 1)
+        this->gray_image = this->image;
+    else if (this->image.channels() == 4)
+        cv::cvtColor(this->image, this->gray_image, cv::COLOR_BGRA2GRAY);
+    else
+        cv::cvtColor(this->image, this->gray_image, cv::COLOR_BGR2GRAY);
+    
+    this->circle = {-1, -1, -1};
+    this->crop_rect = {0, 0, 0, 0};
+    this->user_crop.release();
+    this->gray_crop.release();
+    this->result = mr::RegistrationResult();
+}
+
+
+EXPORT_SYMBOL bool MoonRegistrationPipeline::run(
+    const int knn_k,
+    const float good_match_ratio,
+    const int find_homography_method,
+    const double find_homography_ransac_reproj_threshold
+)
+{
+    this->result = mr::RegistrationResult();
+    try
+    {
+        if (this->image.empty())
+            throw std::runtime_error("Empty Input Image");
+        if (this->model.image.empty() || this->f2d_detector.empty())
+            throw std::runtime_error("Empty model image or Feature2D detector");
+        
+        // detection on a borrowed view of the shared gray image,
+        // gray_image outlives detect_moon()
+        this->detector.init_by_mat_view(this->gray_image);
+        this->circle = this->detector.detect_moon();
+        if (!mr::is_valid_circle(this->circle))
+            throw std::runtime_error("Cannot find moon in input image");
+        
+        // crop, both crops are ROI views
+        mr::cut_ref_image_from_circle(
+            this->image, this->user_crop, this->crop_rect,
+            this->circle, this->crop_padding
+        );
+        this->gray_crop = this->gray_image(mr::rectangle_to_roi(this->crop_rect));
+        
+        // registration, keypoints are extracted from gray crop directly
+        this->f2d_detector->detectAndCompute(
+            this->gray_crop, cv::noArray(),
+            this->user_keypoints, this->user_descriptors
+        );
+        mr::register_with_model_features(
+            this->model, this->user_crop,
+            this->user_keypoints, this->user_descriptors,
+            this->match_batch, this->result,
+            cv::Mat(), 1.0f, NULL,
+            knn_k, good_match_ratio,
+            find_homography_method, find_homography_ransac_reproj_threshold,
+            this->is_good_match, this->filter_good_matches,
+            this->estimate_homography, this->estimator_params
+        );
+    }
+    catch (const std::exception& error)
+    {
+        this->result.success = false;
+        this->result.error_message = error.what();
+    }
+    return this->result.success;
+}
+
+EXPORT_SYMBOL void MoonRegistrationPipeline::draw_layer_image(
+    cv::Mat& image_out,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    if (!this->result.success)
+        throw std::runtime_error("No successful registration");
+    if (this->layer_image.empty())
+        throw std::runtime_error("Empty layer image");
+    mr::draw_layer_image(
+        this->user_crop, this->result.homography_matrix,
+        this->layer_image, image_out,
+        layer_image_transparency, filter_px
+    );
+}
+
+}
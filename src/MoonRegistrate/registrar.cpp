@@ -1,10 +1,14 @@
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/core/utility.hpp>
 
 #include <exception>
+#include <algorithm>
+#include <cmath>
 
 #include "MoonRegistration/MoonRegistrate/registrar.hpp"
 #include "MoonRegistration/imgprocess.hpp"
+#include "MoonRegistration/utils.hpp"
 
 // include MoonRegistration header first, so we get MR_HAVE_OPENCV_NONFREE macro
 #ifdef MR_HAVE_OPENCV_NONFREE
@@ -39,6 +43,11 @@ EXPORT_SYMBOL void create_f2d_detector(const mr::RegistrationAlgorithms algorith
         break;
 #endif
     
+    // feature-free algorithms
+    case mr::RegistrationAlgorithms::FOURIER_MELLIN:
+        f2d_detector.reset();
+        break;
+    
     case mr::RegistrationAlgorithms::EMPTY_ALGORITHM:
         break;
     case mr::RegistrationAlgorithms::INVALID_ALGORITHM:
@@ -50,6 +59,650 @@ EXPORT_SYMBOL void create_f2d_detector(const mr::RegistrationAlgorithms algorith
     }
 }
 
+EXPORT_SYMBOL std::vector<mr::RegistrationTier> default_registration_cascade()
+{
+    mr::RegistrationTier fast_tier;
+    fast_tier.algorithm = mr::RegistrationAlgorithms::ORB;
+    fast_tier.working_resolution = 512;
+    fast_tier.min_inlier_ratio = 0.5f;
+    fast_tier.max_reprojection_error = 2.0;
+    
+    mr::RegistrationTier full_tier;
+    full_tier.algorithm = mr::RegistrationAlgorithms::SIFT;
+    full_tier.working_resolution = -1;
+    
+    return {fast_tier, full_tier};
+}
+
+EXPORT_SYMBOL void transform_layer_image(
+    const cv::Size& user_image_size,
+    const cv::Mat& homography_matrix,
+    const cv::Mat& layer_image_in,
+    cv::Mat& layer_image_out
+)
+{
+    if (homography_matrix.empty())
+        throw std::runtime_error("Empty homography_matrix");
+    
+    cv::Mat layer_image = layer_image_in.clone();
+    mr::sync_img_size(user_image_size.width, user_image_size.height, layer_image);
+    mr::warp_image(layer_image, layer_image_out, homography_matrix.inv(), layer_image.size());
+}
+
+// sample layer_image at (x, y) with bilinear interpolation, pixels outside of
+// layer_image are (0,0,0,0), same as cv::warpPerspective() with cv::BORDER_CONSTANT.
+// returns false when all 4 neighbors are outside of layer_image
+static bool layer_sample_bilinear(
+    const cv::Mat& layer_image,
+    const int layer_channel,
+    const double x,
+    const double y,
+    uchar* px_out
+)
+{
+    if (x <= -1.0 || y <= -1.0 || x >= layer_image.cols || y >= layer_image.rows)
+        return false;
+    
+    const int x0 = static_cast<int>(std::floor(x));
+    const int y0 = static_cast<int>(std::floor(y));
+    const float fx = static_cast<float>(x - x0);
+    const float fy = static_cast<float>(y - y0);
+    const float weights[4] = {
+        (1.0f - fx) * (1.0f - fy), fx * (1.0f - fy),
+        (1.0f - fx) * fy,          fx * fy
+    };
+    
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 4; ++i)
+    {
+        const int xx = x0 + (i & 1);
+        const int yy = y0 + (i >> 1);
+        if (xx < 0 || yy < 0 || xx >= layer_image.cols || yy >= layer_image.rows)
+            continue;
+        const uchar* px = layer_image.ptr<uchar>(yy) + xx * layer_channel;
+        for (int c = 0; c < layer_channel; ++c)
+            acc[c] += weights[i] * px[c];
+    }
+    for (int c = 0; c < layer_channel; ++c)
+        px_out[c] = cv::saturate_cast<uchar>(acc[c]);
+    return true;
+}
+
+// Compute where layer image is drawn on user_image, same as draw_layer_image_reference().
+// Reference path syncs layer image to user_image size, and mr::stack_imgs() centers
+// the synced layer image inside user_image.
+// 
+// Parameters:
+//   - user_size: size of user image
+//   - layer_size: size of original layer image
+//   - homography_matrix: homography matrix maps user image to model image
+//   - to_layer: output matrix maps user image pixel to original layer image pixel
+//   - layer_roi: output rectangle of synced layer image inside user image
+// 
+// Returns:
+//   - false if layer image cannot be synced with user image
+static bool calc_layer_image_mapping(
+    const cv::Size& user_size,
+    const cv::Size& layer_size,
+    const cv::Mat& homography_matrix,
+    cv::Matx33d& to_layer,
+    cv::Rect& layer_roi
+)
+{
+    if (homography_matrix.size() != cv::Size(3, 3) || layer_size.width <= 0 || layer_size.height <= 0)
+        return false;
+    
+    const cv::Size synced_size = mr::calc_sync_img_size(user_size.width, user_size.height, layer_size);
+    int offset_x = -1, offset_y = -1;
+    if (synced_size.width == user_size.width)
+    {
+        offset_x = 0;
+        offset_y = (user_size.height - synced_size.height) / 2;
+    }
+    else if (synced_size.height == user_size.height)
+    {
+        offset_x = (user_size.width - synced_size.width) / 2;
+        offset_y = 0;
+    }
+    if (offset_x < 0 || offset_y < 0 || synced_size.width <= 0 || synced_size.height <= 0)
+        return false;
+    
+    // homography_matrix maps user image to synced layer image, so one matrix takes
+    // output pixel -> synced layer pixel -> original layer pixel:
+    //   to_layer = scale * homography_matrix * shift
+    cv::Matx33d homography;
+    homography_matrix.convertTo(homography, CV_64F);
+    const double scale_x = static_cast<double>(layer_size.width) / synced_size.width;
+    const double scale_y = static_cast<double>(layer_size.height) / synced_size.height;
+    const cv::Matx33d scale(
+        scale_x, 0.0, 0.5 * scale_x - 0.5,
+        0.0, scale_y, 0.5 * scale_y - 0.5,
+        0.0, 0.0, 1.0
+    );
+    const cv::Matx33d shift(
+        1.0, 0.0, -offset_x,
+        0.0, 1.0, -offset_y,
+        0.0, 0.0, 1.0
+    );
+    to_layer = scale * homography * shift;
+    layer_roi = cv::Rect(offset_x, offset_y, synced_size.width, synced_size.height);
+    return true;
+}
+
+// number of full resolution layer pixels covered by one output pixel around (x, y),
+// used to select mr::LayerAsset pyramid level
+static double calc_layer_pixel_footprint(const cv::Matx33d& to_layer, const double x, const double y)
+{
+    std::vector<cv::Point2d> points = {{x, y}, {x + 1.0, y}, {x, y + 1.0}}, mapped;
+    cv::perspectiveTransform(points, mapped, to_layer);
+    cv::Point2d dx = mapped[1] - mapped[0];
+    cv::Point2d dy = mapped[2] - mapped[0];
+    return std::sqrt(std::abs(dx.cross(dy)));
+}
+
+namespace
+{
+
+// one layer drawn by draw_layer_image_kernel()
+struct LayerBlendSource
+{
+    // 3 or 4 channels CV_8U layer image, 4 channels if premultiplied
+    cv::Mat layer_image;
+    // from calc_layer_image_mapping(), maps output pixel to layer_image pixel
+    cv::Matx33d to_layer;
+    cv::Rect layer_roi;
+    float transparency_factor = 1.0f;
+    const cv::Vec4b* filter_px = NULL;
+    // false follows mr::stack_imgs(), a pixel is either drawn or not
+    // true blends premultiplied BGRA from mr::LayerAsset with its alpha
+    bool premultiplied = false;
+};
+
+}
+
+// setup a LayerBlendSource for a cv::Mat layer image,
+// returns false if layer_image is not supported by draw_layer_image_kernel()
+// 
+// Note:
+//   - bilinear sampling a layer image larger than the output aliases, so such a layer image
+//     is resized with cv::INTER_AREA to its synced size first, same as mr::transform_layer_image()
+static bool make_layer_blend_source(
+    const cv::Size& user_size,
+    const cv::Mat& homography_matrix,
+    const cv::Mat& layer_image,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px,
+    mr::LayerBlendSource& source
+)
+{
+    if (layer_image.empty() || layer_image.depth() != CV_8U ||
+        (layer_image.channels() != 3 && layer_image.channels() != 4))
+        return false;
+    
+    source.layer_image = layer_image;
+    const cv::Size synced_size = mr::calc_sync_img_size(user_size.width, user_size.height, layer_image.size());
+    if (synced_size.width > 0 && synced_size.height > 0 &&
+        (synced_size.width < layer_image.cols || synced_size.height < layer_image.rows))
+    {
+        cv::Mat prefiltered_layer_image;
+        cv::resize(layer_image, prefiltered_layer_image, synced_size, 0, 0, cv::INTER_AREA);
+        source.layer_image = prefiltered_layer_image;
+    }
+    if (!calc_layer_image_mapping(user_size, source.layer_image.size(), homography_matrix, source.to_layer, source.layer_roi))
+        return false;
+    source.transparency_factor = mr::clamp<float>(layer_image_transparency, 0.0, 1.0);
+    source.filter_px = filter_px;
+    source.premultiplied = false;
+    return true;
+}
+
+// setup a LayerBlendSource for a mr::LayerAsset, pyramid level is selected
+// by the footprint at the center of layer image
+static void make_layer_blend_source(
+    const cv::Size& user_size,
+    const cv::Mat& homography_matrix,
+    const mr::LayerAsset& layer_asset,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px,
+    mr::LayerBlendSource& source
+)
+{
+    if (layer_asset.empty())
+        throw std::runtime_error("Empty layer_asset");
+    
+    cv::Matx33d to_layer;
+    if (!calc_layer_image_mapping(user_size, layer_asset.size(), homography_matrix, to_layer, source.layer_roi))
+        throw std::runtime_error("Cannot sync layer image with user_image");
+    const int level = layer_asset.select_level(calc_layer_pixel_footprint(
+        to_layer,
+        source.layer_roi.x + source.layer_roi.width / 2.0,
+        source.layer_roi.y + source.layer_roi.height / 2.0
+    ));
+    source.layer_image = layer_asset.get_level(level);
+    source.to_layer = layer_asset.get_level_transform(level) * to_layer;
+    source.transparency_factor = mr::clamp<float>(layer_image_transparency, 0.0, 1.0);
+    source.filter_px = filter_px;
+    source.premultiplied = true;
+}
+
+// Fused warp & blend kernel, every output pixel is inverse mapped into every layer image
+// in order, sampled, and blended in a single pass parallel over rows.
+// Layers are blended in order, so a layer is drawn on top of all the layers before it.
+// 
+// Parameters:
+//   - user_image: 3 or 4 channels CV_8U background
+//   - sources: layers to draw, from make_layer_blend_source()
+//   - source_count: number of layers in sources
+//   - image_out: 4 channels output, same size as user_image.
+//     its buffer is reused if it already has the same size & type
+static void draw_layer_image_kernel(
+    const cv::Mat& user_image,
+    const mr::LayerBlendSource* sources,
+    const size_t source_count,
+    cv::Mat& image_out
+)
+{
+    // image_out shares buffer with user_image, draw into a new cv::Mat
+    if (!image_out.empty() && image_out.datastart == user_image.datastart)
+    {
+        cv::Mat fused_out;
+        draw_layer_image_kernel(user_image, sources, source_count, fused_out);
+        image_out = fused_out;
+        return;
+    }
+    
+    const int user_channel = user_image.channels();
+    image_out.create(user_image.size(), CV_8UC4);
+    
+    cv::parallel_for_(cv::Range(0, user_image.rows), [&](const cv::Range& range)
+    {
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const uchar* user_row = user_image.ptr<uchar>(y);
+            uchar* out_row = image_out.ptr<uchar>(y);
+            
+            for (int x = 0; x < user_image.cols; ++x)
+            {
+                const uchar* back_px = user_row + x * user_channel;
+                // background has at least 3 channels, missing alpha is 255
+                uchar px[4] = {
+                    back_px[0], back_px[1], back_px[2],
+                    (user_channel == 4) ? back_px[3] : static_cast<uchar>(255)
+                };
+                
+                for (size_t i = 0; i < source_count; ++i)
+                {
+                    const mr::LayerBlendSource& source = sources[i];
+                    const cv::Rect& roi = source.layer_roi;
+                    if (y < roi.y || y >= roi.y + roi.height || x < roi.x || x >= roi.x + roi.width)
+                        continue;
+                    
+                    // inverse map into layer image
+                    const cv::Matx33d& to_layer = source.to_layer;
+                    const double w = to_layer(2, 0) * x + to_layer(2, 1) * y + to_layer(2, 2);
+                    if (w == 0.0)
+                        continue;
+                    const double layer_x = (to_layer(0, 0) * x + to_layer(0, 1) * y + to_layer(0, 2)) / w;
+                    const double layer_y = (to_layer(1, 0) * x + to_layer(1, 1) * y + to_layer(1, 2)) / w;
+                    const int layer_channel = source.layer_image.channels();
+                    uchar fore[4] = {0, 0, 0, 0};
+                    if (!layer_sample_bilinear(source.layer_image, layer_channel, layer_x, layer_y, fore))
+                        continue;
+                    
+                    // alpha, 3 channel layer pixel is opaque when its gray value is not 0,
+                    // gray value uses the same fixed point weights as cv::COLOR_BGR2GRAY
+                    if (layer_channel == 3)
+                        fore[3] = ((fore[0] * 1868 + fore[1] * 9617 + fore[2] * 4899 + 8192) >> 14) > 0 ? 255 : 0;
+                    if (fore[3] == 0)
+                        continue;
+                    const cv::Vec4b* filter_px = source.filter_px;
+                    if (filter_px)
+                    {
+                        // filter_px is a straight color, un-premultiply pixels of mr::LayerAsset before comparing
+                        uchar straight[4] = {fore[0], fore[1], fore[2], fore[3]};
+                        if (source.premultiplied && fore[3] < 255)
+                            for (int c = 0; c < 3; ++c)
+                                straight[c] = static_cast<uchar>(std::min((fore[c] * 255 + fore[3] / 2) / fore[3], 255));
+                        if (straight[0] <= filter_px->val[0] && straight[1] <= filter_px->val[1] &&
+                            straight[2] <= filter_px->val[2] && straight[3] <= filter_px->val[3])
+                            continue;
+                    }
+                    
+                    const float transparency_factor = source.transparency_factor;
+                    if (source.premultiplied)
+                    {
+                        // out = fore + back * (1 - alpha), fore is already multiplied by its alpha
+                        const float back_factor = 1.0f - transparency_factor * fore[3] / 255.0f;
+                        for (int c = 0; c < 4; ++c)
+                            px[c] = cv::saturate_cast<uchar>(px[c] * back_factor + fore[c] * transparency_factor);
+                    }
+                    else
+                    {
+                        for (int c = 0; c < 4; ++c)
+                            px[c] = static_cast<uchar>(
+                                px[c] * (1.0 - transparency_factor) + fore[c] * transparency_factor
+                            );
+                    }
+                }
+                
+                uchar* out_px = out_row + x * 4;
+                out_px[0] = px[0];
+                out_px[1] = px[1];
+                out_px[2] = px[2];
+                out_px[3] = px[3];
+            }
+        }
+    });
+}
+
+// Fused version of draw_layer_image_reference(), every output pixel is inverse mapped
+// into the layer image, sampled, and blended in a single pass.
+// 
+// Returns:
+//   - false if inputs are not supported, caller should fallback to draw_layer_image_reference()
+static bool draw_layer_image_fused(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const cv::Mat& layer_image_in,
+    cv::Mat& image_out,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    if (user_image.depth() != CV_8U || (user_image.channels() != 3 && user_image.channels() != 4))
+        return false;
+    
+    mr::LayerBlendSource source;
+    if (!make_layer_blend_source(
+        user_image.size(), homography_matrix, layer_image_in,
+        layer_image_transparency, filter_px, source))
+        return false;
+    
+    draw_layer_image_kernel(user_image, &source, 1, image_out);
+    return true;
+}
+
+EXPORT_SYMBOL void draw_layer_image(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const cv::Mat& layer_image_in,
+    cv::Mat& image_out,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    if (user_image.empty())
+        throw std::runtime_error("Empty user_image");
+    if (homography_matrix.empty())
+        throw std::runtime_error("Empty homography_matrix");
+    
+    if (draw_layer_image_fused(
+        user_image, homography_matrix, layer_image_in, image_out,
+        layer_image_transparency, filter_px))
+        return;
+    
+    mr::draw_layer_image_reference(
+        user_image, homography_matrix, layer_image_in, image_out,
+        layer_image_transparency, filter_px
+    );
+}
+
+EXPORT_SYMBOL void transform_layer_image(
+    const cv::Size& user_image_size,
+    const cv::Mat& homography_matrix,
+    const mr::LayerAsset& layer_asset,
+    cv::Mat& layer_image_out
+)
+{
+    if (homography_matrix.empty())
+        throw std::runtime_error("Empty homography_matrix");
+    if (layer_asset.empty())
+        throw std::runtime_error("Empty layer_asset");
+    
+    // synced layer pixel -> full resolution layer pixel -> level pixel
+    const cv::Size synced_size = mr::calc_sync_img_size(user_image_size.width, user_image_size.height, layer_asset.size());
+    const double scale_x = static_cast<double>(layer_asset.size().width) / synced_size.width;
+    const double scale_y = static_cast<double>(layer_asset.size().height) / synced_size.height;
+    const cv::Matx33d scale(
+        scale_x, 0.0, 0.5 * scale_x - 0.5,
+        0.0, scale_y, 0.5 * scale_y - 0.5,
+        0.0, 0.0, 1.0
+    );
+    cv::Matx33d homography;
+    homography_matrix.convertTo(homography, CV_64F);
+    const cv::Matx33d to_layer = scale * homography;
+    const int level = layer_asset.select_level(
+        calc_layer_pixel_footprint(to_layer, synced_size.width / 2.0, synced_size.height / 2.0)
+    );
+    const cv::Matx33d to_level = layer_asset.get_level_transform(level) * to_layer;
+    
+    mr::warp_image(
+        layer_asset.get_level(level), layer_image_out,
+        cv::Mat(to_level), synced_size,
+        cv::INTER_LINEAR | cv::WARP_INVERSE_MAP
+    );
+}
+
+EXPORT_SYMBOL void draw_layer_image(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const mr::LayerAsset& layer_asset,
+    cv::Mat& image_out,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    if (user_image.empty())
+        throw std::runtime_error("Empty user_image");
+    if (homography_matrix.empty())
+        throw std::runtime_error("Empty homography_matrix");
+    if (layer_asset.empty())
+        throw std::runtime_error("Empty layer_asset");
+    if (user_image.depth() != CV_8U)
+        throw std::runtime_error("Only CV_8U user_image is supported");
+    
+    cv::Mat user_image_bgr = user_image;
+    if (user_image.channels() == 1)
+        cv::cvtColor(user_image, user_image_bgr, cv::COLOR_GRAY2BGR);
+    
+    mr::LayerBlendSource source;
+    make_layer_blend_source(
+        user_image.size(), homography_matrix, layer_asset,
+        layer_image_transparency, filter_px, source
+    );
+    draw_layer_image_kernel(user_image_bgr, &source, 1, image_out);
+}
+
+EXPORT_SYMBOL void draw_layer_images(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const std::vector<mr::LayerDrawItem>& layers,
+    cv::Mat& image_out
+)
+{
+    if (user_image.empty())
+        throw std::runtime_error("Empty user_image");
+    if (homography_matrix.empty())
+        throw std::runtime_error("Empty homography_matrix");
+    if (user_image.depth() != CV_8U)
+        throw std::runtime_error("Only CV_8U user_image is supported");
+    
+    cv::Mat user_image_bgr = user_image;
+    if (user_image.channels() == 1)
+        cv::cvtColor(user_image, user_image_bgr, cv::COLOR_GRAY2BGR);
+    
+    // warp setup of every layer is done once, then all the layers are blended in one pass
+    std::vector<mr::LayerBlendSource> sources(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        const mr::LayerDrawItem& layer = layers[i];
+        const cv::Vec4b* filter_px = layer.use_filter_px ? &layer.filter_px : NULL;
+        if (layer.layer_asset)
+        {
+            make_layer_blend_source(
+                user_image.size(), homography_matrix, *layer.layer_asset,
+                layer.layer_image_transparency, filter_px, sources[i]
+            );
+        }
+        else if (!make_layer_blend_source(
+            user_image.size(), homography_matrix, layer.layer_image,
+            layer.layer_image_transparency, filter_px, sources[i]))
+            throw std::runtime_error("Layer image must be a 3 or 4 channels CV_8U image");
+    }
+    
+    draw_layer_image_kernel(user_image_bgr, sources.data(), sources.size(), image_out);
+}
+
+EXPORT_SYMBOL void draw_layer_image_reference(
+    const cv::Mat& user_image,
+    const cv::Mat& homography_matrix,
+    const cv::Mat& layer_image_in,
+    cv::Mat& image_out,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    if (user_image.empty())
+        throw std::runtime_error("Empty user_image");
+    
+    // pre-process layer image
+    cv::Mat processed_layer_image;
+    mr::transform_layer_image(user_image.size(), homography_matrix, layer_image_in, processed_layer_image);
+    
+    
+    // create our own alpha channel for layer image if needed
+    cv::Mat transparent_layer_image;
+    if (processed_layer_image.channels() < 4)
+    {
+        // create alpha channel for layer image
+        cv::Mat gray_processed_layer_image, alpha;
+        cv::cvtColor(processed_layer_image, gray_processed_layer_image, cv::COLOR_BGR2GRAY);
+        cv::threshold(gray_processed_layer_image, alpha, 0, 255, cv::THRESH_BINARY);
+        
+        // merge alpha into a layer image
+        mr::ImageChannels processed_layer_image_channels;
+        mr::split_img_channel(processed_layer_image, processed_layer_image_channels);
+        processed_layer_image_channels.channels.push_back(alpha);
+        mr::merge_img_channel(processed_layer_image_channels, transparent_layer_image);
+    }
+    else // channels == 4
+        transparent_layer_image = processed_layer_image;
+    
+    
+    mr::stack_imgs(
+        user_image,
+        cv::Rect({0,0}, user_image.size()),
+        transparent_layer_image,
+        image_out,
+        layer_image_transparency,
+        filter_px
+    );
+}
+
+
+// gray value of a sampled pixel, same fixed point weights as cv::COLOR_BGR2GRAY
+static inline uchar registrar_px_to_gray(const uchar* px, const int channel)
+{
+    if (channel == 1)
+        return px[0];
+    return static_cast<uchar>((px[0] * 1868 + px[1] * 9617 + px[2] * 4899 + 8192) >> 14);
+}
+
+EXPORT_SYMBOL void draw_stacked_red_green_image(
+    const cv::Mat& user_image,
+    const cv::Mat& model_image,
+    const cv::Mat& homography_matrix,
+    cv::Mat& image_out,
+    const int preview_resolution
+)
+{
+    if (user_image.empty() || model_image.empty())
+        throw std::runtime_error("Empty user_image or model_image");
+    if (homography_matrix.size() != cv::Size(3, 3))
+        throw std::runtime_error("Invalid homography_matrix");
+    if (user_image.depth() != CV_8U || model_image.depth() != CV_8U)
+        throw std::runtime_error("Only CV_8U images are supported");
+    
+    // output size, longer side fits in preview_resolution
+    cv::Size out_size = user_image.size();
+    if (preview_resolution > 0 && std::max(out_size.width, out_size.height) > preview_resolution)
+    {
+        double ratio = static_cast<double>(preview_resolution) / std::max(out_size.width, out_size.height);
+        out_size = cv::Size(
+            std::max(1, cvRound(out_size.width * ratio)),
+            std::max(1, cvRound(out_size.height * ratio))
+        );
+    }
+    
+    // output pixel -> full resolution pixel, pixel centers are aligned
+    const double scale_x = static_cast<double>(user_image.cols) / out_size.width;
+    const double scale_y = static_cast<double>(user_image.rows) / out_size.height;
+    const cv::Matx33d to_full(
+        scale_x, 0.0, 0.5 * scale_x - 0.5,
+        0.0, scale_y, 0.5 * scale_y - 0.5,
+        0.0, 0.0, 1.0
+    );
+    // red: user image warped into model perspective, sampled through inverse homography
+    cv::Matx33d homography;
+    homography_matrix.convertTo(homography, CV_64F);
+    const cv::Matx33d to_user = homography.inv() * to_full;
+    // green: model image resized to user image size
+    const double model_x = static_cast<double>(model_image.cols) / user_image.cols;
+    const double model_y = static_cast<double>(model_image.rows) / user_image.rows;
+    const cv::Matx33d to_model = cv::Matx33d(
+        model_x, 0.0, 0.5 * model_x - 0.5,
+        0.0, model_y, 0.5 * model_y - 0.5,
+        0.0, 0.0, 1.0
+    ) * to_full;
+    
+    const int user_channel = user_image.channels();
+    const int model_channel = model_image.channels();
+    image_out.create(out_size, CV_8UC3);
+    
+    cv::parallel_for_(cv::Range(0, out_size.height), [&](const cv::Range& range)
+    {
+        for (int y = range.start; y < range.end; ++y)
+        {
+            uchar* out_row = image_out.ptr<uchar>(y);
+            for (int x = 0; x < out_size.width; ++x)
+            {
+                uchar px[4] = {0, 0, 0, 0};
+                uchar red = 0;
+                const double w = to_user(2, 0) * x + to_user(2, 1) * y + to_user(2, 2);
+                if (w != 0.0)
+                {
+                    const double user_x = (to_user(0, 0) * x + to_user(0, 1) * y + to_user(0, 2)) / w;
+                    const double user_y = (to_user(1, 0) * x + to_user(1, 1) * y + to_user(1, 2)) / w;
+                    if (layer_sample_bilinear(user_image, user_channel, user_x, user_y, px))
+                        red = registrar_px_to_gray(px, user_channel);
+                }
+                
+                // cv::resize() replicates border pixels
+                const double m_x = mr::clamp<double>(to_model(0, 0) * x + to_model(0, 2), 0.0, model_image.cols - 1);
+                const double m_y = mr::clamp<double>(to_model(1, 1) * y + to_model(1, 2), 0.0, model_image.rows - 1);
+                layer_sample_bilinear(model_image, model_channel, m_x, m_y, px);
+                
+                uchar* out_px = out_row + x * 3;
+                out_px[0] = 0;                                          // B
+                out_px[1] = registrar_px_to_gray(px, model_channel);    // G
+                out_px[2] = red;                                        // R
+            }
+        }
+    });
+}
+
+// convert image_in to a single channel gray image, image_out buffer is reused when it fits
+static void registrar_convert_to_gray(const cv::Mat& image_in, cv::Mat& image_out)
+{
+    if (image_in.channels() == 4)
+        cv::cvtColor(image_in, image_out, cv::COLOR_BGRA2GRAY);
+    else if (image_in.channels() == 3)
+        cv::cvtColor(image_in, image_out, cv::COLOR_BGR2GRAY);
+    else
+        image_in.copyTo(image_out);
+}
+
+
 EXPORT_SYMBOL MoonRegistrar::MoonRegistrar()
 {
 }
@@ -116,25 +769,22 @@ EXPORT_SYMBOL void MoonRegistrar::update_images(
 }
 EXPORT_SYMBOL void MoonRegistrar::update_images(const cv::Mat& user_image, const cv::Mat& model_image)
 {
-    this->user_image = user_image.clone();
-    if (this->user_image.empty())
-        throw std::runtime_error("Input User Image is empty");
-    this->model_image = model_image.clone();
-    if (this->user_image.empty())
-        throw std::runtime_error("Input User Image is empty");
-    
-    // pre-processing
-    mr::sync_img_size(this->user_image, this->model_image);
-    this->image_size = this->user_image.size();
+    this->__init_images(user_image, model_image, false);
+}
+EXPORT_SYMBOL void MoonRegistrar::update_images_view(const cv::Mat& user_image, const cv::Mat& model_image)
+{
+    this->__init_images(user_image, model_image, true);
 }
 
 EXPORT_SYMBOL void MoonRegistrar::update_f2d_detector(const mr::RegistrationAlgorithms& algorithm)
 {
     mr::create_f2d_detector(algorithm, this->f2d_detector);
+    this->algorithm = algorithm;
 }
 EXPORT_SYMBOL void MoonRegistrar::update_f2d_detector(const cv::Ptr<cv::Feature2D>& f2d_detector)
 {
     this->f2d_detector = f2d_detector;
+    this->algorithm = mr::RegistrationAlgorithms::EMPTY_ALGORITHM;
 }
 
 EXPORT_SYMBOL void MoonRegistrar::update_homography_matrix(const cv::Mat& homography_matrix)
@@ -144,7 +794,73 @@ EXPORT_SYMBOL void MoonRegistrar::update_homography_matrix(const cv::Mat& homogr
 
 EXPORT_SYMBOL void MoonRegistrar::update_good_keypoint_matches(const std::vector<std::vector<cv::DMatch>>& good_keypoint_matches)
 {
-    this->good_keypoint_matches = good_keypoint_matches;
+    this->good_matches.clear();
+    this->good_matches.reserve(good_keypoint_matches.size());
+    for (const auto& match : good_keypoint_matches)
+    {
+        if (!match.empty())
+            this->good_matches.push_back(match[0]);
+    }
+    this->__sync_good_keypoint_matches();
+    // inlier mask belongs to previous good_keypoint_matches
+    this->homography_inlier_mask.clear();
+    this->inlier_count = 0;
+}
+
+EXPORT_SYMBOL void MoonRegistrar::update_motion_model(const mr::MotionModel& motion_model)
+{
+    this->motion_model = motion_model;
+}
+
+EXPORT_SYMBOL void MoonRegistrar::update_estimator_params(
+    const int max_iters,
+    const double confidence
+)
+{
+    this->estimator_max_iters = max_iters;
+    this->estimator_confidence = confidence;
+}
+
+EXPORT_SYMBOL void MoonRegistrar::update_keypoint_mask(const float keypoint_mask_ratio)
+{
+    this->keypoint_mask_ratio = keypoint_mask_ratio;
+    this->user_mask_circle = {-1, -1, -1};
+    this->model_mask_circle = {-1, -1, -1};
+}
+
+EXPORT_SYMBOL void MoonRegistrar::update_keypoint_mask(
+    const mr::Circle& user_circle,
+    const mr::Circle& model_circle,
+    const float keypoint_mask_ratio
+)
+{
+    this->keypoint_mask_ratio = keypoint_mask_ratio;
+    this->user_mask_circle = user_circle;
+    this->model_mask_circle = model_circle;
+}
+
+EXPORT_SYMBOL void MoonRegistrar::update_working_resolution(const int working_resolution)
+{
+    this->working_resolution = working_resolution;
+}
+
+EXPORT_SYMBOL void MoonRegistrar::update_registration_cascade(const std::vector<mr::RegistrationTier>& registration_cascade)
+{
+    this->registration_cascade = registration_cascade;
+}
+
+EXPORT_SYMBOL void MoonRegistrar::update_warp_cache_epsilon(const double warp_cache_epsilon)
+{
+    this->warp_cache_epsilon = warp_cache_epsilon;
+    this->clear_warp_cache();
+}
+
+EXPORT_SYMBOL void MoonRegistrar::clear_warp_cache()
+{
+    this->warp_cache_layer_in.release();
+    this->warp_cache_layer_out.release();
+    this->warp_cache_homography.release();
+    this->warp_cache_image_size = cv::Size();
 }
 
 
@@ -155,20 +871,61 @@ EXPORT_SYMBOL void MoonRegistrar::compute_registration(
     const double find_homography_ransac_reproj_threshold
 )
 {
+    // feature-free algorithms
+    if (this->algorithm == mr::RegistrationAlgorithms::FOURIER_MELLIN)
+    {
+        if (this->user_image.empty() || this->model_image.empty())
+            throw std::runtime_error("Empty user_image or model_image");
+        this->__clear_keypoints();
+        this->phase_correlation_response = mr::register_fourier_mellin(
+            this->user_image, this->model_image, this->homography_matrix
+        );
+        return;
+    }
+    
     if (this->f2d_detector.empty())
         throw std::runtime_error("Empty Feature2D detector");
     
+    // downscale both images to working_resolution if needed,
+    // keypoints & homography_matrix are computed in downscaled coordinate,
+    // and we will rescale them back to full resolution at the end.
+    // filter images keep the color channels of user_image & model_image,
+    // and they always share the coordinate of keypoints
+    cv::Mat filter_user_image = this->user_image;
+    cv::Mat filter_model_image = this->model_image;
+    bool use_working_resolution = (
+        this->working_resolution > 0 &&
+        std::max(this->image_size.width, this->image_size.height) > this->working_resolution
+    );
+    if (use_working_resolution)
+    {
+        double ratio = (
+            static_cast<double>(this->working_resolution) /
+            static_cast<double>(std::max(this->image_size.width, this->image_size.height))
+        );
+        cv::resize(this->user_image, filter_user_image, cv::Size(), ratio, ratio, cv::INTER_AREA);
+        cv::resize(this->model_image, filter_model_image, cv::Size(), ratio, ratio, cv::INTER_AREA);
+    }
     cv::Mat gray_user_image, gray_model_image;
-    cv::cvtColor(this->user_image, gray_user_image, cv::COLOR_BGR2GRAY);
-    cv::cvtColor(this->model_image, gray_model_image, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(filter_user_image, gray_user_image, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(filter_model_image, gray_model_image, cv::COLOR_BGR2GRAY);
+    
+    // only extract keypoints inside the moon when keypoint mask is enabled
+    cv::Mat user_mask, model_mask;
+    if (this->keypoint_mask_ratio > 0.0f)
+    {
+        double scale = static_cast<double>(gray_user_image.cols) / static_cast<double>(this->user_image.cols);
+        this->__create_keypoint_mask(gray_user_image.size(), this->user_mask_circle, scale, user_mask);
+        this->__create_keypoint_mask(gray_model_image.size(), this->model_mask_circle, scale, model_mask);
+    }
     
     // compute keypoints & descriptors
     cv::Mat tmp_user_descriptors, tmp_model_descriptors;
     this->f2d_detector->detectAndCompute(
-        gray_user_image, cv::noArray(), this->user_keypoints, tmp_user_descriptors
+        gray_user_image, user_mask, this->user_keypoints, tmp_user_descriptors
     );
     this->f2d_detector->detectAndCompute(
-        gray_model_image, cv::noArray(), this->model_keypoints, tmp_model_descriptors
+        gray_model_image, model_mask, this->model_keypoints, tmp_model_descriptors
     );
     
     // matching keypoints
@@ -176,58 +933,246 @@ EXPORT_SYMBOL void MoonRegistrar::compute_registration(
     std::vector<std::vector<cv::DMatch>> matches;
     bf_matcher.knnMatch(tmp_user_descriptors, tmp_model_descriptors, matches, knn_k);
     
-    // only allocate 75% of matches buffer, assuming good_matches are 75% of matches
-    int keypoints_buffer_size = static_cast<int>(matches.size()*0.75);
-    this->good_keypoint_matches.reserve(keypoints_buffer_size);
+    // filter good matches
     std::vector<cv::Point2f> tmp_user_keypoints_pt2f;
-    tmp_user_keypoints_pt2f.reserve(keypoints_buffer_size);
     std::vector<cv::Point2f> tmp_model_keypoints_pt2f;
-    tmp_model_keypoints_pt2f.reserve(keypoints_buffer_size);
-    
-    // filter good matches
-    for (auto mn : matches)
-    {
-        const cv::KeyPoint& user_kpt = this->user_keypoints[mn[0].queryIdx];
-        const cv::KeyPoint& model_kpt = this->model_keypoints[mn[0].trainIdx];
-        bool flag = this->is_good_match(
-            mn[0], mn[1],
-            good_match_ratio,
-            user_kpt, model_kpt,
-            this->user_image, this->model_image
-        );
-        if (flag)
-        {
-            this->good_keypoint_matches.push_back(std::vector<cv::DMatch>({mn[0]}));
-            
-            tmp_user_keypoints_pt2f.push_back(user_kpt.pt);
-            tmp_model_keypoints_pt2f.push_back(model_kpt.pt);
-        }
-    }
-    this->good_keypoint_matches.shrink_to_fit();
+    this->good_keypoint_matches.clear();
+    mr::select_good_matches(
+        matches, this->user_keypoints, this->model_keypoints,
+        filter_user_image, filter_model_image,
+        good_match_ratio,
+        this->is_good_match, this->filter_good_matches,
+        this->match_batch,
+        this->good_matches,
+        tmp_user_keypoints_pt2f,
+        tmp_model_keypoints_pt2f
+    );
+    this->__sync_good_keypoint_matches();
     
     // compute homography matrix
-    if (tmp_user_keypoints_pt2f.size() < 4 || tmp_model_keypoints_pt2f.size() < 4)
+    size_t min_points = static_cast<size_t>(mr::min_points_of_motion_model(this->motion_model));
+    if (tmp_user_keypoints_pt2f.size() < min_points || tmp_model_keypoints_pt2f.size() < min_points)
         throw std::runtime_error("No enough keypoints for finding homography matrix");
-    this->homography_matrix = cv::findHomography(
+    if (!this->estimate_homography)
+        throw std::runtime_error("Empty estimate_homography");
+    std::vector<float> match_distances;
+    match_distances.reserve(this->good_matches.size());
+    for (const auto& match : this->good_matches)
+        match_distances.push_back(match.distance);
+    mr::EstimatorParams estimator_params;
+    estimator_params.motion_model = this->motion_model;
+    estimator_params.method = find_homography_method;
+    estimator_params.ransac_reproj_threshold = find_homography_ransac_reproj_threshold;
+    estimator_params.max_iters = this->estimator_max_iters;
+    estimator_params.confidence = this->estimator_confidence;
+    this->homography_matrix = this->estimate_homography(
         tmp_user_keypoints_pt2f,
         tmp_model_keypoints_pt2f,
-        find_homography_method,
-        find_homography_ransac_reproj_threshold
+        match_distances,
+        estimator_params,
+        this->homography_inlier_mask
     );
+    this->inlier_count = mr::count_inliers(this->homography_inlier_mask);
     if (this->homography_matrix.empty())
         throw std::runtime_error("Cannot find Homography Matrix");
+    
+    // rescale keypoints & homography_matrix back to full resolution
+    if (use_working_resolution)
+    {
+        cv::Matx33d user_scale = mr::calc_scale_matrix(gray_user_image.size(), this->user_image.size());
+        cv::Matx33d model_scale = mr::calc_scale_matrix(gray_model_image.size(), this->model_image.size());
+        mr::rescale_keypoints(this->user_keypoints, user_scale);
+        mr::rescale_keypoints(this->model_keypoints, model_scale);
+        
+        // homography_matrix maps downscaled user_image to downscaled model_image,
+        // so full resolution homography_matrix = model_scale * H * inv(user_scale),
+        // both scale matrices map pixel centers with the half pixel offset
+        cv::Matx33d low_res_homography = this->homography_matrix;
+        cv::Mat(model_scale * low_res_homography * user_scale.inv()).copyTo(this->homography_matrix);
+    }
+}
+
+EXPORT_SYMBOL int MoonRegistrar::compute_registration_cascade(
+    const int knn_k,
+    const float good_match_ratio,
+    const int find_homography_method,
+    const double find_homography_ransac_reproj_threshold
+)
+{
+    if (this->registration_cascade.empty())
+        throw std::runtime_error("Empty registration_cascade");
+    
+    cv::Ptr<cv::Feature2D> original_f2d_detector = this->f2d_detector;
+    mr::RegistrationAlgorithms original_algorithm = this->algorithm;
+    int original_working_resolution = this->working_resolution;
+    
+    // registration state of the last successful tier,
+    // a failed tier may leave a stale or partial state behind
+    cv::Mat last_homography;
+    std::vector<cv::KeyPoint> last_user_keypoints;
+    std::vector<cv::KeyPoint> last_model_keypoints;
+    std::vector<cv::DMatch> last_good_matches;
+    std::vector<std::vector<cv::DMatch>> last_good_keypoint_matches;
+    std::vector<unsigned char> last_homography_inlier_mask;
+    int last_inlier_count = 0;
+    double last_phase_correlation_response = 0.0;
+    auto save_state = [&]() {
+        last_homography = this->homography_matrix;
+        last_user_keypoints = this->user_keypoints;
+        last_model_keypoints = this->model_keypoints;
+        last_good_matches = this->good_matches;
+        last_good_keypoint_matches = this->good_keypoint_matches;
+        last_homography_inlier_mask = this->homography_inlier_mask;
+        last_inlier_count = this->inlier_count;
+        last_phase_correlation_response = this->phase_correlation_response;
+    };
+    auto restore_state = [&]() {
+        this->homography_matrix = last_homography;
+        this->user_keypoints = last_user_keypoints;
+        this->model_keypoints = last_model_keypoints;
+        this->good_matches = last_good_matches;
+        this->good_keypoint_matches = last_good_keypoint_matches;
+        this->homography_inlier_mask = last_homography_inlier_mask;
+        this->inlier_count = last_inlier_count;
+        this->phase_correlation_response = last_phase_correlation_response;
+    };
+    auto restore_settings = [&]() {
+        this->f2d_detector = original_f2d_detector;
+        this->algorithm = original_algorithm;
+        this->working_resolution = original_working_resolution;
+    };
+    
+    this->cascade_tier = -1;
+    bool has_homography = false;
+    std::string last_error;
+    try
+    {
+        for (size_t i = 0; i < this->registration_cascade.size(); ++i)
+        {
+            const mr::RegistrationTier& tier = this->registration_cascade[i];
+            this->update_f2d_detector(tier.algorithm);
+            this->working_resolution = tier.working_resolution;
+            
+            try
+            {
+                this->compute_registration(
+                    knn_k, good_match_ratio,
+                    find_homography_method,
+                    find_homography_ransac_reproj_threshold
+                );
+            }
+            catch (const std::runtime_error& error)
+            {
+                restore_state();
+                last_error = error.what();
+                continue;
+            }
+            has_homography = true;
+            save_state();
+            
+            bool accepted = true;
+            if (this->algorithm == mr::RegistrationAlgorithms::FOURIER_MELLIN)
+                accepted = (this->phase_correlation_response >= tier.min_phase_correlation_response);
+            else
+            {
+                double inlier_ratio = (
+                    this->good_matches.empty() ? 0.0 :
+                    static_cast<double>(this->inlier_count) / static_cast<double>(this->good_matches.size())
+                );
+                // max_reprojection_error is in pixels of working_resolution,
+                // calc_reprojection_error() measures in pixels of full resolution model_image
+                double max_reprojection_error = tier.max_reprojection_error;
+                int max_side = std::max(this->image_size.width, this->image_size.height);
+                if (tier.working_resolution > 0 && max_side > tier.working_resolution)
+                    max_reprojection_error *= static_cast<double>(max_side) / static_cast<double>(tier.working_resolution);
+                
+                if (inlier_ratio < tier.min_inlier_ratio)
+                    accepted = false;
+                else if (max_reprojection_error > 0.0 &&
+                    this->calc_reprojection_error() > max_reprojection_error)
+                    accepted = false;
+            }
+            if (accepted)
+            {
+                this->cascade_tier = static_cast<int>(i);
+                break;
+            }
+        }
+    }
+    catch (...)
+    {
+        // keep the registrar usable when a tier throws something else
+        restore_state();
+        restore_settings();
+        throw;
+    }
+    restore_settings();
+    
+    if (!has_homography)
+        throw std::runtime_error("No registration tier can find Homography Matrix: " + last_error);
+    return this->cascade_tier;
+}
+
+EXPORT_SYMBOL void MoonRegistrar::compute_registration_by_circles(
+    const mr::Circle& user_circle,
+    const mr::Circle& model_circle,
+    const int canonical_radius,
+    const int angle_steps
+)
+{
+    if (this->user_image.empty() || this->model_image.empty())
+        throw std::runtime_error("Empty user_image or model_image");
+    
+    this->__clear_keypoints();
+    this->angular_correlation_score = mr::register_by_circles(
+        this->user_image, user_circle,
+        this->model_image, model_circle,
+        this->homography_matrix,
+        canonical_radius, angle_steps
+    );
+}
+
+EXPORT_SYMBOL double MoonRegistrar::calc_reprojection_error()
+{
+    this->__validate_registrar();
+    
+    bool has_inlier_mask = (this->homography_inlier_mask.size() == this->good_matches.size());
+    std::vector<cv::Point2f> user_pts, model_pts;
+    user_pts.reserve(this->good_matches.size());
+    model_pts.reserve(this->good_matches.size());
+    for (size_t i = 0; i < this->good_matches.size(); ++i)
+    {
+        if (has_inlier_mask && !this->homography_inlier_mask[i])
+            continue;
+        const cv::DMatch& match = this->good_matches[i];
+        user_pts.push_back(this->user_keypoints[match.queryIdx].pt);
+        model_pts.push_back(this->model_keypoints[match.trainIdx].pt);
+    }
+    if (user_pts.empty())
+        return 0.0;
+    
+    std::vector<cv::Point2f> projected_pts;
+    cv::perspectiveTransform(user_pts, projected_pts, this->homography_matrix);
+    
+    double error_sum = 0.0;
+    for (size_t i = 0; i < projected_pts.size(); ++i)
+    {
+        cv::Point2f diff = projected_pts[i] - model_pts[i];
+        error_sum += std::sqrt(diff.x * diff.x + diff.y * diff.y);
+    }
+    return error_sum / static_cast<double>(projected_pts.size());
 }
 
 EXPORT_SYMBOL void MoonRegistrar::transform_image(const cv::Mat& image_in, cv::Mat& image_out)
 {
     this->__validate_image_matrix();
-    cv::warpPerspective(image_in, image_out, this->homography_matrix, image_in.size());
+    mr::warp_image(image_in, image_out, this->homography_matrix, image_in.size());
 }
 
 EXPORT_SYMBOL void MoonRegistrar::transform_image_inverse(const cv::Mat& image_in, cv::Mat& image_out)
 {
     this->__validate_image_matrix();
-    cv::warpPerspective(image_in, image_out, this->homography_matrix.inv(), image_in.size());
+    mr::warp_image(image_in, image_out, this->homography_matrix.inv(), image_in.size());
 }
 
 EXPORT_SYMBOL void MoonRegistrar::transform_user_image(cv::Mat& image_out)
@@ -238,9 +1183,21 @@ EXPORT_SYMBOL void MoonRegistrar::transform_user_image(cv::Mat& image_out)
 
 EXPORT_SYMBOL void MoonRegistrar::transform_layer_image(const cv::Mat& layer_image_in, cv::Mat& layer_image_out)
 {
-    layer_image_out = layer_image_in.clone();
-    mr::sync_img_size(this->user_image, layer_image_out);
-    this->transform_image_inverse(layer_image_out, layer_image_out);
+    this->__validate_image_matrix();
+    if (this->warp_cache_epsilon < 0.0)
+    {
+        mr::transform_layer_image(this->image_size, this->homography_matrix, layer_image_in, layer_image_out);
+        return;
+    }
+    
+    // share the cached buffer, a miss writes a new buffer so earlier outputs are never overwritten
+    layer_image_out = this->__transform_layer_image_cached(layer_image_in);
+}
+
+EXPORT_SYMBOL void MoonRegistrar::transform_layer_image(const mr::LayerAsset& layer_asset, cv::Mat& layer_image_out)
+{
+    this->__validate_image_matrix();
+    mr::transform_layer_image(this->image_size, this->homography_matrix, layer_asset, layer_image_out);
 }
 
 
@@ -251,86 +1208,100 @@ EXPORT_SYMBOL void MoonRegistrar::draw_matched_keypoints(cv::Mat& image_out)
     cv::drawMatches(
         this->user_image, this->user_keypoints,
         this->model_image, this->model_keypoints,
-        this->good_keypoint_matches,
+        this->good_matches,
         image_out,
         cv::Scalar::all(-1),
         cv::Scalar::all(-1),
-        std::vector<std::vector<char>>(),
+        std::vector<char>(),
         cv::DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS
     );
 }
 
 EXPORT_SYMBOL void MoonRegistrar::draw_red_transformed_user_image(cv::Mat& image_out, const cv::Mat& transformed_image_in)
 {
-    this->__validate_registrar();
+    this->__validate_image_matrix();
+    // draw image with user_image's size, reuse image_out if it already fits
+    image_out.create(this->image_size, CV_8UC3);
+    this->draw_red_transformed_user_image_into(image_out, transformed_image_in);
+}
+
+EXPORT_SYMBOL void MoonRegistrar::draw_red_transformed_user_image_into(cv::Mat& image_out, const cv::Mat& transformed_image_in)
+{
+    this->__validate_image_matrix();
+    this->__validate_output_buffer(image_out, this->image_size, CV_8UC3);
     
-    cv::Mat transformed_image;
+    const cv::Mat* transformed_image = &transformed_image_in;
     if (transformed_image_in.empty())
-        this->transform_user_image(transformed_image);
-    else
-        transformed_image = transformed_image_in;
-    
-    if (transformed_image.size() != this->image_size)
+    {
+        this->transform_user_image(this->scratch_transformed);
+        transformed_image = &this->scratch_transformed;
+    }
+    if (transformed_image->size() != this->image_size)
         throw std::runtime_error("Transformed Image size not match with original image size");
     
-    cv::cvtColor(transformed_image, transformed_image, cv::COLOR_BGR2GRAY);
-    // draw image with user_image's size
-    cv::Size image_size(transformed_image.size());
-    
-    cv::merge(
-        std::vector<cv::Mat>({
-            cv::Mat::zeros(image_size, CV_8UC1),        // B
-            cv::Mat::zeros(image_size, CV_8UC1),        // G
-            transformed_image                           // R
-        }),
-        image_out
-    );
+    registrar_convert_to_gray(*transformed_image, this->scratch_gray);
+    image_out.setTo(cv::Scalar::all(0));
+    const int from_to[] = {0, 2}; // R
+    cv::mixChannels(&this->scratch_gray, 1, &image_out, 1, from_to, 1);
 }
 
 EXPORT_SYMBOL void MoonRegistrar::draw_green_model_image(cv::Mat& image_out)
 {
-    this->__validate_registrar();
+    this->__validate_image_matrix();
+    // draw image with model_image's size, reuse image_out if it already fits
+    image_out.create(this->model_image.size(), CV_8UC3);
+    this->draw_green_model_image_into(image_out);
+}
+
+EXPORT_SYMBOL void MoonRegistrar::draw_green_model_image_into(cv::Mat& image_out)
+{
+    this->__validate_image_matrix();
+    this->__validate_output_buffer(image_out, this->model_image.size(), CV_8UC3);
     
-    cv::Mat gray_model_image;
-    cv::cvtColor(this->model_image, gray_model_image, cv::COLOR_BGR2GRAY);
-    // draw image with model_image's size
-    cv::Size image_size(this->model_image.size());
-    
-    cv::merge(
-        std::vector<cv::Mat>({
-            cv::Mat::zeros(image_size, CV_8UC1),        // B
-            gray_model_image,                           // G
-            cv::Mat::zeros(image_size, CV_8UC1)         // R
-        }),
-        image_out
-    );
+    registrar_convert_to_gray(this->model_image, this->scratch_model_gray);
+    image_out.setTo(cv::Scalar::all(0));
+    const int from_to[] = {0, 1}; // G
+    cv::mixChannels(&this->scratch_model_gray, 1, &image_out, 1, from_to, 1);
 }
 
 EXPORT_SYMBOL void MoonRegistrar::draw_stacked_red_green_image(cv::Mat& image_out, const cv::Mat& transformed_image_in)
 {
-    this->__validate_registrar();
-    
-    cv::Mat green;
-    cv::cvtColor(this->model_image, green, cv::COLOR_BGR2GRAY);
-    // resize model_image to user_image's size
-    cv::resize(green, green, this->image_size);
+    this->__validate_image_matrix();
+    image_out.create(this->image_size, CV_8UC3);
+    this->draw_stacked_red_green_image_into(image_out, transformed_image_in);
+}
+
+EXPORT_SYMBOL void MoonRegistrar::draw_stacked_red_green_image_into(cv::Mat& image_out, const cv::Mat& transformed_image_in)
+{
+    this->__validate_image_matrix();
+    this->__validate_output_buffer(image_out, this->image_size, CV_8UC3);
     
-    cv::Mat red;
+    const cv::Mat* red = &transformed_image_in;
     if (transformed_image_in.empty())
-        this->transform_user_image(red);
-    else
-        red = transformed_image_in;
-    if (red.size() != this->image_size)
+    {
+        this->transform_user_image(this->scratch_transformed);
+        red = &this->scratch_transformed;
+    }
+    if (red->size() != this->image_size)
         throw std::runtime_error("Transformed Red Image size not match with original image size");
-    cv::cvtColor(red, red, cv::COLOR_BGR2GRAY);
-    
-    cv::merge(
-        std::vector<cv::Mat>({
-            cv::Mat::zeros(this->image_size, CV_8UC1),  // B
-            green,                                      // G
-            red                                         // R
-        }),
-        image_out
+    registrar_convert_to_gray(*red, this->scratch_gray);
+    
+    // resize model_image to user_image's size
+    registrar_convert_to_gray(this->model_image, this->scratch_model_gray);
+    cv::resize(this->scratch_model_gray, this->scratch_green, this->image_size);
+    
+    image_out.setTo(cv::Scalar::all(0));
+    const cv::Mat sources[] = {this->scratch_green, this->scratch_gray};
+    const int from_to[] = {0, 1, 1, 2}; // G, R
+    cv::mixChannels(sources, 2, &image_out, 1, from_to, 2);
+}
+
+EXPORT_SYMBOL void MoonRegistrar::draw_stacked_red_green_image_fused(cv::Mat& image_out, const int preview_resolution)
+{
+    this->__validate_image_matrix();
+    mr::draw_stacked_red_green_image(
+        this->user_image, this->model_image, this->homography_matrix,
+        image_out, preview_resolution
     );
 }
 
@@ -343,49 +1314,167 @@ EXPORT_SYMBOL void MoonRegistrar::draw_layer_image(
 {
     this->__validate_image_matrix();
     
-    // pre-process layer image
-    cv::Mat processed_layer_image;
-    this->transform_layer_image(layer_image_in, processed_layer_image);
+    // warp cache only applies to transform_layer_image()
+    mr::draw_layer_image(
+        this->user_image,
+        this->homography_matrix,
+        layer_image_in,
+        image_out,
+        layer_image_transparency,
+        filter_px
+    );
+}
+
+EXPORT_SYMBOL void MoonRegistrar::draw_layer_image(
+    const mr::LayerAsset& layer_asset,
+    cv::Mat& image_out,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    this->__validate_image_matrix();
     
+    mr::draw_layer_image(
+        this->user_image,
+        this->homography_matrix,
+        layer_asset,
+        image_out,
+        layer_image_transparency,
+        filter_px
+    );
+}
+
+EXPORT_SYMBOL void MoonRegistrar::draw_layer_image_into(
+    const cv::Mat& layer_image_in,
+    cv::Mat& image_out,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    this->__validate_image_matrix();
+    this->__validate_output_buffer(image_out, this->image_size, CV_8UC4);
+    if (image_out.datastart == this->user_image.datastart)
+        throw std::runtime_error("image_out cannot share buffer with user_image");
+    if (this->user_image.depth() != CV_8U)
+        throw std::runtime_error("Only CV_8U user_image is supported");
+    if (layer_image_in.empty() || layer_image_in.depth() != CV_8U ||
+        (layer_image_in.channels() != 3 && layer_image_in.channels() != 4))
+        throw std::runtime_error("Only 3 or 4 channels CV_8U layer_image is supported");
     
-    // create our own alpha channel for layer image if needed
-    cv::Mat transparent_layer_image;
-    if (processed_layer_image.channels() < 4)
+    // draw directly into image_out, it already has the output size & type.
+    // 1 channel user_image is converted into a scratch buffer, same as the mr::LayerAsset version
+    const cv::Mat* user_image_bgr = &this->user_image;
+    if (this->user_image.channels() == 1)
     {
-        // create alpha channel for layer image
-        cv::Mat gray_processed_layer_image, alpha;
-        cv::cvtColor(processed_layer_image, gray_processed_layer_image, cv::COLOR_BGR2GRAY);
-        cv::threshold(gray_processed_layer_image, alpha, 0, 255, cv::THRESH_BINARY);
-        
-        // merge alpha into a layer image
-        mr::ImageChannels processed_layer_image_channels;
-        mr::split_img_channel(processed_layer_image, processed_layer_image_channels);
-        processed_layer_image_channels.channels.push_back(alpha);
-        mr::merge_img_channel(processed_layer_image_channels, transparent_layer_image);
+        cv::cvtColor(this->user_image, this->scratch_user_bgr, cv::COLOR_GRAY2BGR);
+        user_image_bgr = &this->scratch_user_bgr;
     }
-    else // channels == 4
-        transparent_layer_image = processed_layer_image;
     
+    mr::LayerBlendSource source;
+    if (!make_layer_blend_source(
+        this->image_size, this->homography_matrix, layer_image_in,
+        layer_image_transparency, filter_px, source))
+        throw std::runtime_error("Cannot sync layer image with user_image");
+    draw_layer_image_kernel(*user_image_bgr, &source, 1, image_out);
+}
+
+EXPORT_SYMBOL void MoonRegistrar::draw_layer_image_into(
+    const mr::LayerAsset& layer_asset,
+    cv::Mat& image_out,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    this->__validate_image_matrix();
+    this->__validate_output_buffer(image_out, this->image_size, CV_8UC4);
+    if (image_out.datastart == this->user_image.datastart)
+        throw std::runtime_error("image_out cannot share buffer with user_image");
+    if (this->user_image.depth() != CV_8U)
+        throw std::runtime_error("Only CV_8U user_image is supported");
     
-    mr::stack_imgs(
-        this->user_image,
-        cv::Rect({0,0}, this->image_size),
-        transparent_layer_image,
-        image_out,
-        layer_image_transparency,
-        filter_px
+    // same as mr::draw_layer_image(), but 1 channel user_image is converted into a scratch buffer
+    const cv::Mat* user_image_bgr = &this->user_image;
+    if (this->user_image.channels() == 1)
+    {
+        cv::cvtColor(this->user_image, this->scratch_user_bgr, cv::COLOR_GRAY2BGR);
+        user_image_bgr = &this->scratch_user_bgr;
+    }
+    
+    mr::LayerBlendSource source;
+    make_layer_blend_source(
+        this->image_size, this->homography_matrix, layer_asset,
+        layer_image_transparency, filter_px, source
     );
+    draw_layer_image_kernel(*user_image_bgr, &source, 1, image_out);
+}
+
+EXPORT_SYMBOL void MoonRegistrar::draw_layer_images(const std::vector<mr::LayerDrawItem>& layers, cv::Mat& image_out)
+{
+    this->__validate_image_matrix();
+    mr::draw_layer_images(this->user_image, this->homography_matrix, layers, image_out);
 }
 
 
 // private helper functions
+const cv::Mat& MoonRegistrar::__transform_layer_image_cached(const cv::Mat& layer_image_in)
+{
+    // cache key: same layer image buffer, same user image size, and close enough homography_matrix
+    bool hit = (
+        !this->warp_cache_layer_out.empty() &&
+        this->warp_cache_layer_in.data == layer_image_in.data &&
+        this->warp_cache_layer_in.size() == layer_image_in.size() &&
+        this->warp_cache_layer_in.type() == layer_image_in.type() &&
+        this->warp_cache_image_size == this->image_size
+    );
+    if (hit)
+    {
+        // compare where two homography matrices map the corners of user image
+        std::vector<cv::Point2f> corners = {
+            {0.0f, 0.0f},
+            {static_cast<float>(this->image_size.width), 0.0f},
+            {static_cast<float>(this->image_size.width), static_cast<float>(this->image_size.height)},
+            {0.0f, static_cast<float>(this->image_size.height)}
+        };
+        std::vector<cv::Point2f> cached_corners, new_corners;
+        cv::perspectiveTransform(corners, cached_corners, this->warp_cache_homography);
+        cv::perspectiveTransform(corners, new_corners, this->homography_matrix);
+        for (size_t i = 0; hit && i < corners.size(); ++i)
+            hit = cv::norm(cached_corners[i] - new_corners[i]) <= this->warp_cache_epsilon;
+    }
+    
+    if (hit)
+    {
+        ++this->warp_cache_hits;
+        return this->warp_cache_layer_out;
+    }
+    
+    ++this->warp_cache_misses;
+    // transform into a new buffer, previous outputs may still share the cached one
+    cv::Mat layer_image_out;
+    mr::transform_layer_image(this->image_size, this->homography_matrix, layer_image_in, layer_image_out);
+    this->warp_cache_layer_out = layer_image_out;
+    // keep a reference to layer_image_in, so its buffer cannot be reused by another image
+    this->warp_cache_layer_in = layer_image_in;
+    this->warp_cache_homography = this->homography_matrix.clone();
+    this->warp_cache_image_size = this->image_size;
+    return this->warp_cache_layer_out;
+}
+
+void MoonRegistrar::__validate_output_buffer(const cv::Mat& image_out, const cv::Size& size, const int type)
+{
+    if (image_out.empty())
+        throw std::runtime_error("Empty image_out, it must be preallocated");
+    if (image_out.size() != size || image_out.type() != type)
+        throw std::runtime_error("image_out size or type not match with output");
+}
+
 void MoonRegistrar::__validate_registrar()
 {
     if (this->f2d_detector.empty())
         throw std::runtime_error("Empty Feature2D detector");
     if (this->user_image.empty() || this->model_image.empty())
         throw std::runtime_error("Empty user_image or model_image");
-    if (this->homography_matrix.empty() || this->user_keypoints.empty() || this->model_keypoints.empty() || this->good_keypoint_matches.empty())
+    if (this->homography_matrix.empty() || this->user_keypoints.empty() || this->model_keypoints.empty() || this->good_matches.empty())
         throw std::runtime_error("Empty homography_matrix, good_keypoint_matches, user_keypoints, or model_keypoints");
 }
 
@@ -397,4 +1486,70 @@ void MoonRegistrar::__validate_image_matrix()
         throw std::runtime_error("Empty homography_matrix");
 }
 
+void MoonRegistrar::__clear_keypoints()
+{
+    this->user_keypoints.clear();
+    this->model_keypoints.clear();
+    this->good_matches.clear();
+    this->good_keypoint_matches.clear();
+    this->homography_inlier_mask.clear();
+    this->inlier_count = 0;
+}
+
+void MoonRegistrar::__sync_good_keypoint_matches()
+{
+    this->good_keypoint_matches.clear();
+    this->good_keypoint_matches.reserve(this->good_matches.size());
+    for (const auto& match : this->good_matches)
+        this->good_keypoint_matches.push_back(std::vector<cv::DMatch>({match}));
+}
+
+void MoonRegistrar::__init_images(const cv::Mat& user_image, const cv::Mat& model_image, const bool borrow)
+{
+    if (user_image.empty())
+        throw std::runtime_error("Input User Image is empty");
+    if (model_image.empty())
+        throw std::runtime_error("Input Model Image is empty");
+    
+    this->user_image = borrow ? user_image : user_image.clone();
+    
+    // pre-processing, resize model_image straight from the input,
+    // so it is copied at most once
+    cv::Size synced_size = mr::calc_sync_img_size(user_image.cols, user_image.rows, model_image.size());
+    if (synced_size == model_image.size())
+        this->model_image = borrow ? model_image : model_image.clone();
+    else
+    {
+        cv::Mat model_header = model_image;
+        mr::sync_img_size(user_image.cols, user_image.rows, model_header);
+        this->model_image = model_header;
+    }
+    this->image_size = this->user_image.size();
+}
+
+void MoonRegistrar::__create_keypoint_mask(
+    const cv::Size& image_size,
+    const mr::Circle& circle,
+    const double scale,
+    cv::Mat& mask_out
+)
+{
+    // circle is in full resolution image coordinate, scale it to working resolution.
+    // without a valid circle, guess the moon is at image center, same as mr::filter_by_ignore_edge_kp()
+    mr::Circle mask_circle;
+    if (mr::is_valid_circle(circle))
+    {
+        mask_circle.x = static_cast<int>(circle.x * scale);
+        mask_circle.y = static_cast<int>(circle.y * scale);
+        mask_circle.radius = static_cast<int>(circle.radius * scale * this->keypoint_mask_ratio);
+    }
+    else
+    {
+        mask_circle.x = image_size.width / 2;
+        mask_circle.y = image_size.height / 2;
+        mask_circle.radius = static_cast<int>((image_size.width / 2.0f) * this->keypoint_mask_ratio);
+    }
+    mr::create_circle_mask(image_size, mask_circle, mask_out);
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include <opencv2/imgproc.hpp>
+
+#include <exception>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <cmath>
+
+#include "MoonRegistration/MoonRegistrate/registry.hpp"
+
+
+namespace mr
+{
+
+// size of polar image used by mr::compute_global_signature()
+const int GLOBAL_SIGNATURE_RADIUS_BINS = 16;
+const int GLOBAL_SIGNATURE_ANGLE_BINS = 64;
+const int GLOBAL_SIGNATURE_HARMONICS = 8;
+const int GLOBAL_SIGNATURE_HISTOGRAM_BINS = 16;
+
+EXPORT_SYMBOL void compute_global_signature(const cv::Mat& image, cv::Mat& signature_out)
+{
+    if (image.empty())
+        throw std::runtime_error("Empty image");
+    
+    cv::Mat gray;
+    if (image.channels() == 3)
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    else if (image.channels() == 4)
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = image;
+    
+    // signature only needs a coarse image
+    const int max_side = GLOBAL_SIGNATURE_ANGLE_BINS * 2;
+    if (std::max(gray.cols, gray.rows) > max_side)
+    {
+        double ratio = static_cast<double>(max_side) / static_cast<double>(std::max(gray.cols, gray.rows));
+        cv::resize(gray, gray, cv::Size(), ratio, ratio, cv::INTER_AREA);
+    }
+    
+    // small polar image around image center, one row per angle & one column per radius
+    cv::Mat polar;
+    cv::warpPolar(
+        gray, polar,
+        cv::Size(GLOBAL_SIGNATURE_RADIUS_BINS, GLOBAL_SIGNATURE_ANGLE_BINS),
+        cv::Point2f(gray.cols / 2.0f, gray.rows / 2.0f),
+        std::min(gray.cols, gray.rows) / 2.0f,
+        cv::INTER_LINEAR | cv::WARP_FILL_OUTLIERS | cv::WARP_POLAR_LINEAR
+    );
+    polar.convertTo(polar, CV_32F);
+    
+    signature_out.create(
+        1, GLOBAL_SIGNATURE_RADIUS_BINS + GLOBAL_SIGNATURE_HARMONICS + GLOBAL_SIGNATURE_HISTOGRAM_BINS,
+        CV_32F
+    );
+    cv::Mat radial_part = signature_out.colRange(0, GLOBAL_SIGNATURE_RADIUS_BINS);
+    cv::Mat angular_part = signature_out.colRange(
+        GLOBAL_SIGNATURE_RADIUS_BINS, GLOBAL_SIGNATURE_RADIUS_BINS + GLOBAL_SIGNATURE_HARMONICS
+    );
+    cv::Mat histogram_part = signature_out.colRange(
+        GLOBAL_SIGNATURE_RADIUS_BINS + GLOBAL_SIGNATURE_HARMONICS, signature_out.cols
+    );
+    
+    // radial brightness profile
+    cv::Mat radial_profile;
+    cv::reduce(polar, radial_profile, 0, cv::REDUCE_AVG, CV_32F);
+    cv::normalize(radial_profile, radial_part, 1.0, 0.0, cv::NORM_L2);
+    
+    // angular brightness profile, rotation only shifts it,
+    // so magnitude of its DFT is rotation invariant
+    cv::Mat angular_profile, angular_spectrum;
+    cv::reduce(polar, angular_profile, 1, cv::REDUCE_AVG, CV_32F);
+    cv::dft(angular_profile.reshape(1, 1), angular_spectrum, cv::DFT_COMPLEX_OUTPUT);
+    const cv::Vec2f* spectrum = angular_spectrum.ptr<cv::Vec2f>(0);
+    float* angular = angular_part.ptr<float>(0);
+    float dc = std::max(std::abs(spectrum[0][0]), 1e-6f);
+    for (int k = 0; k < GLOBAL_SIGNATURE_HARMONICS; ++k)
+        angular[k] = std::hypot(spectrum[k + 1][0], spectrum[k + 1][1]) / dc;
+    
+    // brightness histogram of the unwrapped disk
+    cv::Mat histogram;
+    int channels[] = {0};
+    int hist_size[] = {GLOBAL_SIGNATURE_HISTOGRAM_BINS};
+    float range[] = {0.0f, 256.0f};
+    const float* ranges[] = {range};
+    cv::calcHist(&polar, 1, channels, cv::Mat(), histogram, 1, hist_size, ranges);
+    cv::normalize(histogram.reshape(1, 1), histogram_part, 1.0, 0.0, cv::NORM_L1);
+}
+
+EXPORT_SYMBOL ModelRegistry::ModelRegistry(
+    const mr::RegistrationAlgorithms& algorithm,
+    const bool compact_model_descriptors,
+    const int model_descriptor_pca_components
+)
+    : algorithm(algorithm),
+    compact_model_descriptors(compact_model_descriptors),
+    model_descriptor_pca_components(model_descriptor_pca_components)
+{
+    mr::create_f2d_detector(algorithm, this->f2d_detector);
+    if (this->f2d_detector.empty())
+        throw std::runtime_error("mr::ModelRegistry requires a Feature2D algorithm");
+}
+
+EXPORT_SYMBOL int ModelRegistry::add_model(
+    const cv::Mat& model_image,
+    const cv::Mat& layer_image,
+    const std::string& name
+)
+{
+    mr::ModelFeatures features;
+    mr::extract_model_features(
+        model_image, this->f2d_detector, features,
+        this->compact_model_descriptors, this->model_descriptor_pca_components
+    );
+    cv::Mat signature;
+    mr::compute_global_signature(model_image, signature);
+    
+    this->models.push_back(std::move(features));
+    this->layer_images.push_back(layer_image);
+    this->names.push_back(name);
+    this->signatures.push_back(signature);
+    return static_cast<int>(this->models.size()) - 1;
+}
+
+EXPORT_SYMBOL void ModelRegistry::clear()
+{
+    this->models.clear();
+    this->layer_images.clear();
+    this->names.clear();
+    this->signatures.clear();
+}
+
+EXPORT_SYMBOL void ModelRegistry::select_models(
+    const cv::Mat& user_image,
+    const int top_k,
+    std::vector<int>& model_indices
+) const
+{
+    cv::Mat user_signature;
+    mr::compute_global_signature(user_image, user_signature);
+    
+    std::vector<double> distances(this->signatures.size());
+    for (size_t i = 0; i < this->signatures.size(); ++i)
+        distances[i] = cv::norm(user_signature, this->signatures[i], cv::NORM_L2);
+    
+    model_indices.resize(this->signatures.size());
+    std::iota(model_indices.begin(), model_indices.end(), 0);
+    size_t count = model_indices.size();
+    if (top_k > 0)
+        count = std::min(count, static_cast<size_t>(top_k));
+    std::partial_sort(
+        model_indices.begin(), model_indices.begin() + count, model_indices.end(),
+        [&distances](const int lhs, const int rhs) {
+            return distances[lhs] < distances[rhs];
+        }
+    );
+    model_indices.resize(count);
+}
+
+EXPORT_SYMBOL int ModelRegistry::register_image(
+    const cv::Mat& user_image,
+    mr::RegistrationResult& result,
+    const int top_k,
+    const float layer_image_transparency,
+    const cv::Vec4b* filter_px,
+    const int knn_k,
+    const float good_match_ratio,
+    const int find_homography_method,
+    const double find_homography_ransac_reproj_threshold
+)
+{
+    result = mr::RegistrationResult();
+    if (this->models.empty())
+        throw std::runtime_error("Empty mr::ModelRegistry");
+    
+    std::vector<int> candidates;
+    this->select_models(user_image, top_k, candidates);
+    
+    // user features are computed only once for all the candidates
+    std::vector<cv::KeyPoint> user_keypoints;
+    cv::Mat user_descriptors;
+    mr::extract_user_features(user_image, this->f2d_detector, user_keypoints, user_descriptors);
+    
+    // fully match candidates without layer image, only the best one is drawn
+    int best_index = -1;
+    mr::RegistrationResult candidate_result;
+    for (const int index : candidates)
+    {
+        try
+        {
+            mr::register_with_model_features(
+                this->models[index], user_image, user_keypoints, user_descriptors,
+                this->match_batch, candidate_result,
+                cv::Mat(), layer_image_transparency, filter_px,
+                knn_k, good_match_ratio,
+                find_homography_method, find_homography_ransac_reproj_threshold,
+                this->is_good_match, this->filter_good_matches,
+                this->estimate_homography, this->estimator_params
+            );
+        }
+        catch (const std::exception& error)
+        {
+            if (best_index < 0)
+                result.error_message = error.what();
+            continue;
+        }
+        if (best_index < 0 || candidate_result.inlier_count > result.inlier_count)
+        {
+            best_index = index;
+            result = candidate_result;
+        }
+    }
+    if (best_index < 0)
+        return -1;
+    
+    const cv::Mat& layer_image = this->layer_images[best_index];
+    if (!layer_image.empty())
+    {
+        mr::draw_layer_image(
+            user_image, result.homography_matrix,
+            layer_image, result.layer_image_out,
+            layer_image_transparency, filter_px
+        );
+    }
+    return best_index;
+}
+
+}
@@ -0,0 +1,296 @@
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "MoonRegistration/MoonRegistrate/tracker.hpp"
+
+// include MoonRegistration header first, so we get MR_HAVE_OPENCV_VIDEO macro
+#ifdef MR_HAVE_OPENCV_VIDEO
+
+#include <opencv2/video/tracking.hpp>
+
+#include <exception>
+#include <algorithm>
+#include <cmath>
+
+#include "MoonRegistration/MoonDetect/detector.hpp"
+#include "MoonRegistration/imgprocess.hpp"
+#include "MoonRegistration/utils.hpp"
+
+
+namespace mr
+{
+
+// helper function for mr::MoonRegistrationTracker
+// project user_pts with homography_matrix, and only keep the point pairs
+// whose reprojection error <= threshold. returns mean reprojection error of kept pairs
+static double tracker_filter_points_by_reprojection_error(
+    const cv::Mat& homography_matrix,
+    std::vector<cv::Point2f>& user_pts,
+    std::vector<cv::Point2f>& model_pts,
+    const double threshold
+)
+{
+    if (user_pts.empty())
+        return 0.0;
+    
+    std::vector<cv::Point2f> projected_pts;
+    cv::perspectiveTransform(user_pts, projected_pts, homography_matrix);
+    
+    // compact point pairs in-place
+    double error_sum = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < projected_pts.size(); ++i)
+    {
+        cv::Point2f diff = projected_pts[i] - model_pts[i];
+        double error = std::sqrt(diff.x * diff.x + diff.y * diff.y);
+        if (error > threshold)
+            continue;
+        user_pts[count] = user_pts[i];
+        model_pts[count] = model_pts[i];
+        error_sum += error;
+        ++count;
+    }
+    user_pts.resize(count);
+    model_pts.resize(count);
+    
+    return (count > 0) ? (error_sum / static_cast<double>(count)) : 0.0;
+}
+
+
+EXPORT_SYMBOL MoonRegistrationTracker::MoonRegistrationTracker()
+{
+}
+EXPORT_SYMBOL MoonRegistrationTracker::MoonRegistrationTracker(
+    const cv::Mat& model_image,
+    const mr::RegistrationAlgorithms& algorithm
+)
+{
+    this->update_model_image(model_image);
+    this->update_f2d_detector(algorithm);
+}
+
+
+EXPORT_SYMBOL void MoonRegistrationTracker::update_model_image(const cv::Mat& model_image)
+{
+    this->model_image = model_image.clone();
+    if (this->model_image.empty())
+        throw std::runtime_error("Input Model Image is empty");
+    this->reset();
+}
+
+EXPORT_SYMBOL void MoonRegistrationTracker::update_f2d_detector(const mr::RegistrationAlgorithms& algorithm)
+{
+    this->registrar.update_f2d_detector(algorithm);
+}
+
+EXPORT_SYMBOL void MoonRegistrationTracker::update_reanchor_threshold(
+    const int min_inlier_count,
+    const double max_reprojection_error,
+    const int max_keyframe_interval
+)
+{
+    this->min_inlier_count = min_inlier_count;
+    this->max_reprojection_error = max_reprojection_error;
+    this->max_keyframe_interval = max_keyframe_interval;
+}
+
+EXPORT_SYMBOL void MoonRegistrationTracker::reset()
+{
+    this->homography_matrix = cv::Mat();
+    this->reprojection_error = 0.0;
+    this->keyframe = false;
+    this->frame_size = cv::Size();
+    this->prev_pyramid.clear();
+    this->tracked_user_pts.clear();
+    this->tracked_model_pts.clear();
+    this->frames_since_keyframe = 0;
+}
+
+
+EXPORT_SYMBOL bool MoonRegistrationTracker::track(const cv::Mat& frame)
+{
+    if (frame.empty())
+        throw std::runtime_error("Input Frame is empty");
+    if (this->model_image.empty())
+        throw std::runtime_error("Empty model_image");
+    
+    cv::Mat gray_frame;
+    if (frame.channels() == 1)
+        gray_frame = frame;
+    else
+        cv::cvtColor(frame, gray_frame, cv::COLOR_BGR2GRAY);
+    
+    // build image pyramid once per frame, it will be reused as
+    // previous pyramid when tracking next frame
+    std::vector<cv::Mat> pyramid;
+    cv::buildOpticalFlowPyramid(gray_frame, pyramid, this->lk_window_size, this->lk_max_level);
+    
+    bool need_keyframe = (
+        this->tracked_user_pts.empty() ||
+        this->prev_pyramid.empty() ||
+        frame.size() != this->frame_size ||
+        (this->max_keyframe_interval > 0 && this->frames_since_keyframe >= this->max_keyframe_interval)
+    );
+    
+    // try tracking points from previous frame first
+    if (!need_keyframe && this->__track_points(pyramid))
+    {
+        this->keyframe = false;
+        this->frames_since_keyframe += 1;
+        this->prev_pyramid.swap(pyramid);
+        return true;
+    }
+    
+    // tracking lost or degraded, re-anchor with a new keyframe
+    if (!this->__compute_keyframe(frame))
+    {
+        this->reset();
+        return false;
+    }
+    this->keyframe = true;
+    this->frames_since_keyframe = 0;
+    this->frame_size = frame.size();
+    this->prev_pyramid.swap(pyramid);
+    return true;
+}
+
+EXPORT_SYMBOL void MoonRegistrationTracker::transform_layer_image(const cv::Mat& layer_image_in, cv::Mat& layer_image_out)
+{
+    if (this->homography_matrix.empty())
+        throw std::runtime_error("Empty homography_matrix");
+    
+    // layer image shares the same coordinate with model_image
+    cv::Mat layer_image = layer_image_in;
+    mr::sync_img_size(this->model_image, layer_image);
+    
+    // homography_matrix maps frame to model_image, so we can use it
+    // as an inverse map directly without computing its inverse
+    cv::warpPerspective(
+        layer_image, layer_image_out,
+        this->homography_matrix, this->frame_size,
+        cv::INTER_LINEAR | cv::WARP_INVERSE_MAP
+    );
+}
+
+
+// private helper functions
+bool MoonRegistrationTracker::__compute_keyframe(const cv::Mat& frame)
+{
+    mr::Rectangle rect_out;
+    try
+    {
+        // locate the moon, and only register the moon part of the frame
+        mr::MoonDetector detector(frame);
+        mr::Circle circle = detector.detect_moon();
+        if (!mr::is_valid_circle(circle))
+            return false;
+        
+        cv::Mat user_image;
+        mr::cut_ref_image_from_circle(frame, user_image, rect_out, circle);
+        this->registrar.update_images(user_image, this->model_image);
+        this->registrar.compute_registration();
+    }
+    catch (const std::exception&)
+    {
+        // cannot register current frame
+        return false;
+    }
+    
+    // registrar's homography_matrix maps cut user_image to synced model_image,
+    // convert it so it maps the whole frame to original model_image
+    cv::Matx33d offset(
+        1.0, 0.0, static_cast<double>(-rect_out.top_left_x),
+        0.0, 1.0, static_cast<double>(-rect_out.top_left_y),
+        0.0, 0.0, 1.0
+    );
+    cv::Matx33d model_scale = mr::calc_scale_matrix(
+        this->registrar.get_model_image().size(), this->model_image.size()
+    );
+    cv::Matx33d crop_homography = this->registrar.get_homography_matrix();
+    cv::Mat homography = cv::Mat(model_scale * crop_homography * offset);
+    
+    // collect good keypoint matches in frame & original model_image coordinate
+    const std::vector<cv::KeyPoint>& user_keypoints = this->registrar.get_user_keypoints();
+    const std::vector<cv::KeyPoint>& model_keypoints = this->registrar.get_model_keypoints();
+    const std::vector<cv::DMatch>& good_matches = this->registrar.get_good_matches();
+    std::vector<cv::Point2f> user_pts, model_pts;
+    user_pts.reserve(good_matches.size());
+    model_pts.reserve(good_matches.size());
+    for (const auto& match : good_matches)
+    {
+        const cv::Point2f& user_pt = user_keypoints[match.queryIdx].pt;
+        const cv::Point2f& model_pt = model_keypoints[match.trainIdx].pt;
+        user_pts.push_back(cv::Point2f(
+            user_pt.x + static_cast<float>(rect_out.top_left_x),
+            user_pt.y + static_cast<float>(rect_out.top_left_y)
+        ));
+        model_pts.push_back(cv::Point2f(
+            model_pt.x * static_cast<float>(model_scale(0, 0)) + static_cast<float>(model_scale(0, 2)),
+            model_pt.y * static_cast<float>(model_scale(1, 1)) + static_cast<float>(model_scale(1, 2))
+        ));
+    }
+    
+    // only track inliers of keyframe homography
+    double error = mr::tracker_filter_points_by_reprojection_error(
+        homography, user_pts, model_pts, this->max_reprojection_error * 2.0
+    );
+    if (user_pts.size() < 4)
+        return false;
+    
+    this->homography_matrix = homography;
+    this->reprojection_error = error;
+    this->tracked_user_pts.swap(user_pts);
+    this->tracked_model_pts.swap(model_pts);
+    return true;
+}
+
+bool MoonRegistrationTracker::__track_points(const std::vector<cv::Mat>& pyramid)
+{
+    std::vector<cv::Point2f> next_pts;
+    std::vector<unsigned char> status;
+    std::vector<float> lk_error;
+    cv::calcOpticalFlowPyrLK(
+        this->prev_pyramid, pyramid,
+        this->tracked_user_pts, next_pts,
+        status, lk_error,
+        this->lk_window_size, this->lk_max_level
+    );
+    
+    // drop points lost by optical flow
+    std::vector<cv::Point2f> user_pts, model_pts;
+    user_pts.reserve(next_pts.size());
+    model_pts.reserve(next_pts.size());
+    for (size_t i = 0; i < next_pts.size(); ++i)
+    {
+        if (!status[i])
+            continue;
+        user_pts.push_back(next_pts[i]);
+        model_pts.push_back(this->tracked_model_pts[i]);
+    }
+    int min_count = std::max<int>(4, this->min_inlier_count);
+    if (static_cast<int>(user_pts.size()) < min_count)
+        return false;
+    
+    // re-estimate homography from tracked points against fixed model points
+    cv::Mat homography = cv::findHomography(
+        user_pts, model_pts, cv::RANSAC, this->max_reprojection_error * 2.0
+    );
+    if (homography.empty())
+        return false;
+    
+    double error = mr::tracker_filter_points_by_reprojection_error(
+        homography, user_pts, model_pts, this->max_reprojection_error * 2.0
+    );
+    if (static_cast<int>(user_pts.size()) < min_count || error > this->max_reprojection_error)
+        return false;
+    
+    this->homography_matrix = homography;
+    this->reprojection_error = error;
+    this->tracked_user_pts.swap(user_pts);
+    this->tracked_model_pts.swap(model_pts);
+    return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,328 @@
+#include <opencv2/imgproc.hpp>
+
+#include <exception>
+#include <system_error>
+
+#include "MoonRegistration/MoonRegistrate/video_pipeline.hpp"
+#include "MoonRegistration/imgprocess.hpp"
+
+
+namespace mr
+{
+
+// how long an idle stage sleeps before checking its input slot again
+const std::chrono::microseconds VIDEO_PIPELINE_IDLE_WAIT(200);
+
+EXPORT_SYMBOL VideoPipelineSlot::~VideoPipelineSlot()
+{
+    delete this->slot.exchange(nullptr);
+}
+
+EXPORT_SYMBOL bool VideoPipelineSlot::push(std::unique_ptr<mr::VideoPipelineFrame> frame)
+{
+    mr::VideoPipelineFrame* stale = this->slot.exchange(frame.release(), std::memory_order_acq_rel);
+    if (stale == nullptr)
+        return false;
+    delete stale;
+    return true;
+}
+
+EXPORT_SYMBOL std::unique_ptr<mr::VideoPipelineFrame> VideoPipelineSlot::pop()
+{
+    return std::unique_ptr<mr::VideoPipelineFrame>(
+        this->slot.exchange(nullptr, std::memory_order_acq_rel)
+    );
+}
+
+
+EXPORT_SYMBOL VideoPipeline::VideoPipeline(
+    const cv::Mat& model_image,
+    const cv::Mat& layer_image,
+    const mr::RegistrationAlgorithms& algorithm
+)
+{
+    if (model_image.empty())
+        throw std::runtime_error("Input Model Image is empty");
+    if (layer_image.empty())
+        throw std::runtime_error("Input Layer Image is empty");
+    this->model_image = model_image;
+    this->layer_image = layer_image;
+    this->registrar.update_f2d_detector(algorithm);
+    // model features never change, extract them once for all the frames
+    mr::create_f2d_detector(algorithm, this->f2d_detector);
+    if (!this->f2d_detector.empty())
+        mr::extract_model_features(model_image, this->f2d_detector, this->model_features);
+    for (int i = 0; i < VIDEO_PIPELINE_STAGE_COUNT; ++i)
+    {
+        this->stage_done[i] = false;
+        this->processed[i] = 0;
+        this->dropped[i] = 0;
+        this->busy_us[i] = 0;
+    }
+}
+
+EXPORT_SYMBOL VideoPipeline::~VideoPipeline()
+{
+    this->stop();
+}
+
+
+EXPORT_SYMBOL void VideoPipeline::update_layer_params(
+    const float layer_image_transparency,
+    const cv::Vec4b& filter_px
+)
+{
+    this->layer_image_transparency = layer_image_transparency;
+    this->filter_px = filter_px;
+}
+
+
+EXPORT_SYMBOL mr::VideoPipelineStageStats VideoPipeline::get_stage_stats(const mr::VideoPipelineStage& stage) const
+{
+    int idx = static_cast<int>(stage);
+    if (idx < 0 || idx >= VIDEO_PIPELINE_STAGE_COUNT)
+        throw std::runtime_error("Invalid VideoPipelineStage");
+    
+    mr::VideoPipelineStageStats stats;
+    stats.processed = this->processed[idx].load();
+    stats.dropped = this->dropped[idx].load();
+    if (stats.processed > 0)
+        stats.mean_latency_ms = static_cast<double>(this->busy_us[idx].load()) / stats.processed / 1000.0;
+    double elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - this->start_time
+    ).count();
+    if (elapsed > 0.0)
+        stats.throughput_fps = static_cast<double>(stats.processed) / elapsed;
+    return stats;
+}
+
+EXPORT_SYMBOL double VideoPipeline::get_mean_end_to_end_latency_ms() const
+{
+    uint64_t count = this->processed[VIDEO_PIPELINE_STAGE_COUNT - 1].load();
+    if (count == 0)
+        return 0.0;
+    return static_cast<double>(this->end_to_end_us.load()) / count / 1000.0;
+}
+
+
+EXPORT_SYMBOL void VideoPipeline::start(const std::function<bool(cv::Mat&)>& frame_source)
+{
+    if (!frame_source)
+        throw std::runtime_error("Empty frame_source");
+    this->stop();
+    
+    // drop frames left from last run & reset counters
+    for (int i = 0; i < VIDEO_PIPELINE_STAGE_COUNT; ++i)
+    {
+        this->slots[i].pop();
+        this->stage_done[i] = false;
+        this->processed[i] = 0;
+        this->dropped[i] = 0;
+        this->busy_us[i] = 0;
+    }
+    this->end_to_end_us = 0;
+    this->start_time = std::chrono::steady_clock::now();
+    this->running = true;
+    
+    try
+    {
+        this->threads.emplace_back(&VideoPipeline::__run_capture, this, frame_source);
+        for (int i = 1; i < VIDEO_PIPELINE_STAGE_COUNT; ++i)
+            this->threads.emplace_back(&VideoPipeline::__run_stage, this, static_cast<mr::VideoPipelineStage>(i));
+    }
+    catch (const std::system_error&)
+    {
+        this->stop();
+        throw std::runtime_error("Cannot create mr::VideoPipeline threads");
+    }
+}
+
+EXPORT_SYMBOL void VideoPipeline::stop()
+{
+    this->running = false;
+    for (auto& thread : this->threads)
+        if (thread.joinable())
+            thread.join();
+    this->threads.clear();
+}
+
+EXPORT_SYMBOL bool VideoPipeline::try_get_output(mr::VideoPipelineFrame& frame_out)
+{
+    std::unique_ptr<mr::VideoPipelineFrame> frame = this->slots[VIDEO_PIPELINE_STAGE_COUNT - 1].pop();
+    if (!frame)
+        return false;
+    frame_out = std::move(*frame);
+    return true;
+}
+
+
+// private helper functions
+void VideoPipeline::__run_capture(const std::function<bool(cv::Mat&)> frame_source)
+{
+    int64_t frame_index = 0;
+    while (this->running.load())
+    {
+        // read into a new cv::Mat every time, so frame source never
+        // overwrites a frame still used by later stages
+        std::unique_ptr<mr::VideoPipelineFrame> frame(new mr::VideoPipelineFrame());
+        auto begin = std::chrono::steady_clock::now();
+        bool has_frame = false;
+        try
+        {
+            has_frame = frame_source(frame->frame);
+        }
+        catch (const std::exception&)
+        {
+            has_frame = false;
+        }
+        if (!has_frame || frame->frame.empty())
+            break;
+        
+        frame->frame_index = frame_index++;
+        frame->capture_time = begin;
+        this->__record(mr::VideoPipelineStage::CAPTURE, begin);
+        if (this->slots[0].push(std::move(frame)))
+            ++this->dropped[1];
+    }
+    this->stage_done[0] = true;
+}
+
+void VideoPipeline::__run_stage(const mr::VideoPipelineStage stage)
+{
+    const int idx = static_cast<int>(stage);
+    mr::VideoPipelineSlot& input = this->slots[idx - 1];
+    mr::VideoPipelineSlot& output = this->slots[idx];
+    
+    while (this->running.load())
+    {
+        std::unique_ptr<mr::VideoPipelineFrame> frame = input.pop();
+        if (!frame)
+        {
+            // previous stage may push its last frame right before it is done
+            if (this->stage_done[idx - 1].load())
+            {
+                frame = input.pop();
+                if (!frame)
+                    break;
+            }
+            else
+            {
+                std::this_thread::sleep_for(VIDEO_PIPELINE_IDLE_WAIT);
+                continue;
+            }
+        }
+        
+        auto begin = std::chrono::steady_clock::now();
+        try
+        {
+            if (stage == mr::VideoPipelineStage::DETECT)
+                this->__process_detect(*frame);
+            else if (stage == mr::VideoPipelineStage::REGISTER)
+                this->__process_register(*frame);
+            else
+                this->__process_composite(*frame);
+        }
+        catch (const std::exception& error)
+        {
+            frame->success = false;
+            frame->error_message = error.what();
+        }
+        this->__record(stage, begin);
+        
+        if (stage == mr::VideoPipelineStage::COMPOSITE)
+        {
+            auto latency = std::chrono::steady_clock::now() - frame->capture_time;
+            this->end_to_end_us += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(latency).count()
+            );
+            // output slot is read by the user, its drops are not counted
+            output.push(std::move(frame));
+        }
+        else if (output.push(std::move(frame)))
+            ++this->dropped[idx + 1];
+    }
+    this->stage_done[idx] = true;
+}
+
+void VideoPipeline::__process_detect(mr::VideoPipelineFrame& frame)
+{
+    if (frame.frame.channels() == 4)
+        cv::cvtColor(frame.frame, frame.gray_frame, cv::COLOR_BGRA2GRAY);
+    else if (frame.frame.channels() == 3)
+        cv::cvtColor(frame.frame, frame.gray_frame, cv::COLOR_BGR2GRAY);
+    else
+        frame.gray_frame = frame.frame;
+    
+    // frame outlives detect_moon(), so the detector borrows gray_frame
+    this->detector.init_by_mat_view(frame.gray_frame);
+    frame.circle = this->detector.detect_moon();
+    if (!mr::is_valid_circle(frame.circle))
+        throw std::runtime_error("Cannot find moon in current frame");
+    
+    cv::Mat crop;
+    mr::cut_ref_image_from_circle(frame.frame, crop, frame.crop_rect, frame.circle);
+}
+
+void VideoPipeline::__process_register(mr::VideoPipelineFrame& frame)
+{
+    // frame failed in DETECT stage
+    if (!mr::is_valid_circle(frame.circle))
+        return;
+    
+    // frame is not written until COMPOSITE stage, which starts after registration returns
+    cv::Mat crop = frame.frame(mr::rectangle_to_roi(frame.crop_rect));
+    
+    // feature-free algorithms
+    if (this->f2d_detector.empty())
+    {
+        this->registrar.update_images_view(crop, this->model_image);
+        this->registrar.compute_registration();
+        frame.homography_matrix = this->registrar.get_homography_matrix().clone();
+        frame.success = true;
+        return;
+    }
+    
+    // only the crop needs keypoints, homography_matrix maps it to model image synced with crop size
+    mr::extract_user_features(crop, this->f2d_detector, this->user_keypoints, this->user_descriptors);
+    mr::RegistrationResult result;
+    mr::register_with_model_features(
+        this->model_features, crop,
+        this->user_keypoints, this->user_descriptors,
+        this->match_batch, result,
+        cv::Mat(), 1.0f, NULL,
+        2, 0.7f, cv::RANSAC, 5.0,
+        nullptr, mr::default_filter_good_matches,
+        this->registrar.estimate_homography, this->registrar.get_estimator_params()
+    );
+    frame.homography_matrix = result.homography_matrix;
+    frame.success = true;
+}
+
+void VideoPipeline::__process_composite(mr::VideoPipelineFrame& frame)
+{
+    if (!frame.success)
+        return;
+    
+    // draw transformed layer image on the moon crop of frame in place
+    cv::Rect roi = mr::rectangle_to_roi(frame.crop_rect);
+    cv::Mat transformed_layer;
+    mr::transform_layer_image(roi.size(), frame.homography_matrix, this->layer_image, transformed_layer);
+    mr::stack_imgs_in_place(
+        frame.frame, roi,
+        transformed_layer,
+        this->layer_image_transparency,
+        &this->filter_px
+    );
+}
+
+void VideoPipeline::__record(const mr::VideoPipelineStage stage, const std::chrono::steady_clock::time_point& begin)
+{
+    int idx = static_cast<int>(stage);
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    this->busy_us[idx] += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()
+    );
+    ++this->processed[idx];
+}
+
+}
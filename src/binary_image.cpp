@@ -0,0 +1,183 @@
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/hal/hal.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <exception>
+#include <algorithm>
+#include <cmath>
+
+#include "MoonRegistration/binary_image.hpp"
+
+
+namespace mr
+{
+
+// pack one row of CV_8U pixels into bits, non-zero pixels become 1
+static void pack_binary_row(const uchar* src, uchar* dst, const int width)
+{
+    int x = 0;
+#if CV_SIMD128
+    // 16 pixels -> 2 bytes, turn non-zero pixels into 0xFF so their sign bit is set
+    const cv::v_uint8x16 v_zero = cv::v_setzero_u8();
+    const cv::v_uint8x16 v_one = cv::v_setall_u8(1);
+    for (; x + 16 <= width; x += 16)
+    {
+        cv::v_uint8x16 px = cv::v_sub_wrap(v_zero, cv::v_min(cv::v_load(src + x), v_one));
+        int mask = cv::v_signmask(px);
+        dst[x >> 3] = static_cast<uchar>(mask & 0xFF);
+        dst[(x >> 3) + 1] = static_cast<uchar>((mask >> 8) & 0xFF);
+    }
+#endif
+    for (; x < width; x += 8)
+    {
+        const int n = std::min(8, width - x);
+        uchar byte = 0;
+        for (int i = 0; i < n; ++i)
+            byte |= static_cast<uchar>((src[x + i] != 0) << i);
+        dst[x >> 3] = byte;
+    }
+}
+
+// number of 1 bits in a byte
+static int popcount_byte(uchar value)
+{
+    value = static_cast<uchar>(value - ((value >> 1) & 0x55));
+    value = static_cast<uchar>((value & 0x33) + ((value >> 2) & 0x33));
+    return (value + (value >> 4)) & 0x0F;
+}
+
+// number of 1 bits of pixels [x_begin, x_end) in a packed row
+static int count_row_bits(const uchar* row, const int x_begin, const int x_end)
+{
+    if (x_begin >= x_end)
+        return 0;
+    
+    const int first = x_begin >> 3;
+    const int last = (x_end - 1) >> 3;
+    const uchar first_mask = static_cast<uchar>(0xFF << (x_begin & 7));
+    const uchar last_mask = static_cast<uchar>(0xFF >> (7 - ((x_end - 1) & 7)));
+    if (first == last)
+        return popcount_byte(row[first] & first_mask & last_mask);
+    
+    int count = popcount_byte(row[first] & first_mask) + popcount_byte(row[last] & last_mask);
+    // whole bytes in between, cv::hal::normHamming() is a vectorized popcount
+    if (last - first > 1)
+        count += cv::hal::normHamming(row + first + 1, last - first - 1);
+    return count;
+}
+
+EXPORT_SYMBOL BinaryImage::BinaryImage()
+{
+}
+
+EXPORT_SYMBOL BinaryImage::BinaryImage(const cv::Mat& image_in)
+{
+    this->update_image(image_in);
+}
+
+EXPORT_SYMBOL void BinaryImage::update_image(const cv::Mat& image_in)
+{
+    if (image_in.empty())
+        throw std::runtime_error("Empty Input Image");
+    if (image_in.type() != CV_8UC1)
+        throw std::runtime_error("mr::BinaryImage only supports CV_8UC1 image");
+    
+    this->width = image_in.cols;
+    this->bits.create(image_in.rows, (image_in.cols + 7) / 8, CV_8UC1);
+    cv::parallel_for_(cv::Range(0, image_in.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y)
+            pack_binary_row(image_in.ptr<uchar>(y), this->bits.ptr<uchar>(y), this->width);
+    });
+}
+
+EXPORT_SYMBOL void BinaryImage::to_mat(cv::Mat& image_out, const uchar white) const
+{
+    if (this->empty())
+        throw std::runtime_error("Empty mr::BinaryImage");
+    
+    image_out.create(this->bits.rows, this->width, CV_8UC1);
+    cv::parallel_for_(cv::Range(0, this->bits.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const uchar* src = this->bits.ptr<uchar>(y);
+            uchar* dst = image_out.ptr<uchar>(y);
+            for (int x = 0; x < this->width; ++x)
+                dst[x] = ((src[x >> 3] >> (x & 7)) & 1) ? white : 0;
+        }
+    });
+}
+
+EXPORT_SYMBOL int BinaryImage::count_nonzero() const
+{
+    if (this->empty())
+        return 0;
+    
+    // padding bits are 0, so whole rows can be counted
+    if (this->bits.isContinuous())
+        return cv::hal::normHamming(this->bits.ptr<uchar>(0), static_cast<int>(this->bits.total()));
+    int count = 0;
+    for (int y = 0; y < this->bits.rows; ++y)
+        count += cv::hal::normHamming(this->bits.ptr<uchar>(y), this->bits.cols);
+    return count;
+}
+
+EXPORT_SYMBOL int BinaryImage::count_nonzero_in_circle(const mr::Circle& circle_in) const
+{
+    if (this->empty())
+        return 0;
+    
+    // same bounds as mr::calc_circle_brightness_perc(), max bounds are exclusive
+    const int height = this->bits.rows;
+    const int xmin = std::max(circle_in.x - circle_in.radius, 0);
+    const int xmax = std::min(circle_in.x + circle_in.radius, this->width);
+    const int ymin = std::max(circle_in.y - circle_in.radius, 0);
+    const int ymax = std::min(circle_in.y + circle_in.radius, height);
+    const int radius_squared = circle_in.radius * circle_in.radius;
+    
+    int count = 0;
+    for (int y = ymin; y < ymax; ++y)
+    {
+        // pixels inside circle form one span per row, dx * dx <= half_span_squared
+        const int dy = y - circle_in.y;
+        const int half_span_squared = radius_squared - dy * dy;
+        if (half_span_squared < 0)
+            continue;
+        int half_span = static_cast<int>(std::sqrt(static_cast<double>(half_span_squared)));
+        while (half_span * half_span > half_span_squared)
+            --half_span;
+        while ((half_span + 1) * (half_span + 1) <= half_span_squared)
+            ++half_span;
+        
+        count += count_row_bits(
+            this->bits.ptr<uchar>(y),
+            std::max(circle_in.x - half_span, xmin),
+            std::min(circle_in.x + half_span + 1, xmax)
+        );
+    }
+    return count;
+}
+
+
+EXPORT_SYMBOL float calc_img_brightness_perc(
+    const mr::BinaryImage& image_in
+)
+{
+    cv::Size size = image_in.size();
+    return static_cast<float>(
+        static_cast<double>(image_in.count_nonzero()) / static_cast<float>(size.width*size.height)
+    );
+}
+
+EXPORT_SYMBOL float calc_circle_brightness_perc(
+    const mr::BinaryImage& image_in,
+    const mr::Circle& circle_in
+)
+{
+    // divided by the whole image area, same as mr::calc_circle_brightness_perc()
+    cv::Size size = image_in.size();
+    return static_cast<float>(
+        static_cast<double>(image_in.count_nonzero_in_circle(circle_in)) / static_cast<float>(size.width*size.height)
+    );
+}
+
+}
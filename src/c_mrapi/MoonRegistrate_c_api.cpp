@@ -63,4 +63,75 @@ EXPORT_SYMBOL mat_ptr mrc_registrar_draw_layer_image(
     return NULL;
 }
 
+
+EXPORT_SYMBOL layer_asset_ptr mrc_create_layer_asset(
+    mat_ptr layer_image,
+    const int max_levels,
+    char** error_message
+)
+{
+    try
+    {
+        cv::Mat& mat_layer_image = mrc_ptr_to_mat(layer_image);
+        mr::LayerAsset* layer_asset = new mr::LayerAsset(mat_layer_image, max_levels);
+        return reinterpret_cast<layer_asset_ptr>(layer_asset);
+    }
+    catch(const std::exception& error)
+    {
+        if (error_message != NULL)
+            *error_message = (char*)error.what();
+    }
+    return NULL;
+}
+
+EXPORT_SYMBOL void mrc_destroy_layer_asset_ptr(layer_asset_ptr ptr)
+{
+    delete reinterpret_cast<mr::LayerAsset*>(ptr);
+}
+
+EXPORT_SYMBOL mat_ptr mrc_registrar_draw_layer_asset(
+    mat_ptr user_image,
+    mat_ptr model_image,
+    layer_asset_ptr layer_asset,
+    const int mrc_algorithm,
+    const float layer_image_transparency,
+    const unsigned char* filter_px,
+    char** error_message
+)
+{
+    try
+    {
+        if (layer_asset == NULL)
+            throw std::runtime_error("Empty layer_asset");
+        cv::Mat& mat_user_image = mrc_ptr_to_mat(user_image);
+        cv::Mat& mat_model_image = mrc_ptr_to_mat(model_image);
+        const mr::LayerAsset& asset = *reinterpret_cast<mr::LayerAsset*>(layer_asset);
+        
+        mr::MoonRegistrar registrar(
+            mat_user_image, mat_model_image,
+            static_cast<mr::RegistrationAlgorithms>(mrc_algorithm)
+        );
+        
+        registrar.compute_registration();
+        
+        cv::Vec4b vec4b_filter_px;
+        if (filter_px)
+            vec4b_filter_px = cv::Vec4b(filter_px[0], filter_px[1], filter_px[2], filter_px[3]);
+        cv::Mat* image_out = new cv::Mat();
+        registrar.draw_layer_image(
+            asset, *image_out,
+            layer_image_transparency,
+            filter_px ? &vec4b_filter_px : NULL
+        );
+        
+        return mrc_matptr_to_ptr(image_out);
+    }
+    catch(const std::exception& error)
+    {
+        if (error_message != NULL)
+            *error_message = (char*)error.what();
+    }
+    return NULL;
+}
+
 }
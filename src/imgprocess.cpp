@@ -1,3 +1,10 @@
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <exception>
+#include <cmath>
+#include <vector>
+
 #include "MoonRegistration/imgprocess.hpp"
 #include "MoonRegistration/utils.hpp"
 
@@ -96,6 +103,13 @@ EXPORT_SYMBOL void apply_brightness_contrast(
     double alpha_c = 0.0;
     double gamma_c = 0.0;
     
+    // 8-bit image, both steps in one lookup table pass
+    if (image_in.depth() == CV_8U)
+    {
+        mr::PointOpChain().brightness_contrast(brightness, contrast).apply(image_in, image_out);
+        return;
+    }
+    
     if (brightness != 0)
     {
         if (brightness > 0)
@@ -126,6 +140,110 @@ EXPORT_SYMBOL void apply_brightness_contrast(
     }
 }
 
+// cv::addWeighted(src, alpha, src, 0, gamma, dst) on one CV_8U value,
+// cv::addWeighted() computes 8-bit images in float
+static uchar add_weighted_px(const uchar value, const double alpha, const double gamma)
+{
+    return cv::saturate_cast<uchar>(
+        static_cast<float>(value) * static_cast<float>(alpha) + static_cast<float>(gamma)
+    );
+}
+
+EXPORT_SYMBOL PointOpChain::PointOpChain()
+{
+    this->reset();
+}
+
+EXPORT_SYMBOL PointOpChain& PointOpChain::threshold(const double thresh, const double maxval, const int type)
+{
+    if (type < cv::THRESH_BINARY || type > cv::THRESH_TOZERO_INV)
+        throw std::runtime_error("Unsupported threshold type for mr::PointOpChain");
+    
+    // same integer thresh & maxval as cv::threshold() on CV_8U
+    const int ithresh = cvFloor(thresh);
+    const int imaxval = cvRound(maxval);
+    for (int i = 0; i < 256; ++i)
+    {
+        const int v = this->table[i];
+        int out = v;
+        switch (type)
+        {
+        case cv::THRESH_BINARY:
+            out = (v > ithresh) ? imaxval : 0;
+            break;
+        case cv::THRESH_BINARY_INV:
+            out = (v > ithresh) ? 0 : imaxval;
+            break;
+        case cv::THRESH_TRUNC:
+            out = (v > ithresh) ? ithresh : v;
+            break;
+        case cv::THRESH_TOZERO:
+            out = (v > ithresh) ? v : 0;
+            break;
+        case cv::THRESH_TOZERO_INV:
+            out = (v > ithresh) ? 0 : v;
+            break;
+        }
+        this->table[i] = cv::saturate_cast<uchar>(out);
+    }
+    return *this;
+}
+
+EXPORT_SYMBOL PointOpChain& PointOpChain::brightness_contrast(const int brightness, const int contrast)
+{
+    // same steps as mr::apply_brightness_contrast()
+    if (brightness != 0)
+    {
+        int shadow = (brightness > 0) ? brightness : 0;
+        int highlight = (brightness > 0) ? 255 : 255 + brightness;
+        double alpha_b = (double)(highlight - shadow)/255.0;
+        double gamma_b = (double)shadow;
+        for (int i = 0; i < 256; ++i)
+            this->table[i] = add_weighted_px(this->table[i], alpha_b, gamma_b);
+    }
+    if (contrast != 0)
+    {
+        double f = 131.0*((double)contrast + 127.0)/(127.0*(131.0-(double)contrast));
+        double alpha_c = f;
+        double gamma_c = 127.0*(1.0-f);
+        for (int i = 0; i < 256; ++i)
+            this->table[i] = add_weighted_px(this->table[i], alpha_c, gamma_c);
+    }
+    return *this;
+}
+
+EXPORT_SYMBOL PointOpChain& PointOpChain::binarize(const double thresh, const double maxval)
+{
+    // same steps as mr::binarize_image()
+    this->brightness_contrast(0, 127);
+    this->threshold(thresh, maxval, cv::THRESH_BINARY);
+    return *this;
+}
+
+EXPORT_SYMBOL PointOpChain& PointOpChain::append(const PointOpChain& other)
+{
+    for (int i = 0; i < 256; ++i)
+        this->table[i] = other.table[this->table[i]];
+    return *this;
+}
+
+EXPORT_SYMBOL void PointOpChain::reset()
+{
+    for (int i = 0; i < 256; ++i)
+        this->table[i] = static_cast<uchar>(i);
+}
+
+EXPORT_SYMBOL void PointOpChain::apply(const cv::Mat& image_in, cv::Mat& image_out) const
+{
+    if (image_in.empty())
+        throw std::runtime_error("Empty Input Image");
+    if (image_in.depth() != CV_8U)
+        throw std::runtime_error("mr::PointOpChain only supports CV_8U image");
+    
+    // cv::LUT() is vectorized & runs in parallel
+    cv::LUT(image_in, this->get_lut(), image_out);
+}
+
 EXPORT_SYMBOL float calc_img_brightness_perc(
     const cv::Mat& image_in
 )
@@ -201,19 +319,39 @@ EXPORT_SYMBOL void binarize_image(
     if (image_in.channels() != 1)
         cv::cvtColor(buff, buff, cv::COLOR_BGR2GRAY);
     
-    // set img to maximum contrast
-    // only leave black & white pixels
-    // usually, moon will be white after this conversion
-    mr::apply_brightness_contrast(buff, buff, 0, 127);
-    
-    // set gray image to black & white only image by setting its threshold
-    // opencv impl of threshold
+    // set img to maximum contrast, only leave black & white pixels,
+    // usually, moon will be white after this conversion.
+    // then set gray image to black & white only image by setting its threshold
     // dst[j] = src[j] > thresh ? maxval : 0;
     // using threshold to binarize img will rm all the branching when calculating img_brightness_perc
     // which make calculation much faster
-    cv::threshold(buff, buff, thresh, maxval, cv::THRESH_BINARY);
+    if (buff.depth() == CV_8U)
+    {
+        // both steps in one lookup table pass, straight into image_out
+        mr::PointOpChain().binarize(thresh, maxval).apply(buff, image_out);
+        return;
+    }
     
-    image_out = buff.clone();
+    mr::apply_brightness_contrast(buff, buff, 0, 127);
+    cv::threshold(buff, buff, thresh, maxval, cv::THRESH_BINARY);
+    image_out = buff;
+}
+
+EXPORT_SYMBOL void create_circle_mask(
+    const cv::Size& size,
+    const mr::Circle& circle_in,
+    cv::Mat& mask_out
+)
+{
+    mask_out.create(size, CV_8UC1);
+    mask_out.setTo(cv::Scalar::all(0));
+    cv::circle(
+        mask_out,
+        cv::Point(circle_in.x, circle_in.y),
+        circle_in.radius,
+        cv::Scalar::all(255),
+        cv::FILLED
+    );
 }
 
 EXPORT_SYMBOL void cut_ref_image_from_circle(
@@ -318,6 +456,60 @@ EXPORT_SYMBOL void sync_img_size(const int primary_width, const int primary_heig
     );
 }
 
+EXPORT_SYMBOL cv::Size calc_sync_img_size(const int primary_width, const int primary_height, const cv::Size& secondary_size)
+{
+    // follows the same logic as sync_img_size() & resize_with_aspect_ratio()
+    double width_ratio = (
+        static_cast<double>(primary_width) /
+        static_cast<double>(secondary_size.width)
+    );
+    double height_ratio = (
+        static_cast<double>(primary_height) /
+        static_cast<double>(secondary_size.height)
+    );
+    
+    // sync size by width won't make height be out of bound
+    if ((width_ratio * secondary_size.height) <= primary_height)
+    {
+        float r = static_cast<float>(primary_width) / static_cast<float>(secondary_size.width);
+        return cv::Size(primary_width, static_cast<int>(secondary_size.height * r));
+    }
+    // sync size by height won't make width be out of bound
+    else if ((height_ratio * secondary_size.width) <= primary_width)
+    {
+        float r = static_cast<float>(primary_height) / static_cast<float>(secondary_size.height);
+        return cv::Size(static_cast<int>(secondary_size.width * r), primary_height);
+    }
+    
+    return secondary_size;
+}
+
+EXPORT_SYMBOL void warp_image(
+    const cv::Mat& image_in,
+    cv::Mat& image_out,
+    const cv::Mat& homography_matrix,
+    const cv::Size& size,
+    const int flags
+)
+{
+    cv::Matx33d homography = homography_matrix;
+    bool is_affine = (
+        std::fabs(homography(2, 0)) < 1e-12 &&
+        std::fabs(homography(2, 1)) < 1e-12 &&
+        std::fabs(homography(2, 2) - 1.0) < 1e-12
+    );
+    if (is_affine)
+    {
+        cv::Matx23d affine(
+            homography(0, 0), homography(0, 1), homography(0, 2),
+            homography(1, 0), homography(1, 1), homography(1, 2)
+        );
+        cv::warpAffine(image_in, image_out, affine, size, flags);
+    }
+    else
+        cv::warpPerspective(image_in, image_out, homography_matrix, size, flags);
+}
+
 EXPORT_SYMBOL void sync_img_channel(const cv::Mat& primary, cv::Mat& secondary)
 {
     // get number of channels
@@ -485,6 +677,174 @@ EXPORT_SYMBOL void merge_img_channel(const mr::ImageChannels& channels, cv::Mat&
     cv::merge(channels.channels, image_out);
 }
 
+// foreground weight of mr::stack_imgs() & mr::stack_imgs_in_place() is a fixed-point
+// integer out of (1 << STACK_IMGS_WEIGHT_BITS), so 8 bits pixels blend in 16 bits integers
+const int STACK_IMGS_WEIGHT_BITS = 8;
+
+// whether a foreground pixel is drawn by mr::stack_imgs() & mr::stack_imgs_in_place()
+template<int FORE_CH>
+static inline bool stack_imgs_show_fore(const uchar* fore_px, const cv::Vec4b* filter_px)
+{
+    // 4 channel foreground, checking alpha
+    // 3 channel foreground, checking if fore_px(b,g,r) == (0,0,0)
+    // 1 channel foreground, checking if fore_px(b) == 0
+    bool show_fore = false;
+    if (FORE_CH == 4)
+        show_fore = fore_px[3] > 0;
+    else if (FORE_CH == 3)
+        show_fore = (fore_px[0] | fore_px[1] | fore_px[2]) > 0;
+    else
+        show_fore = fore_px[0] > 0;
+    
+    // when fore_px value <= filter_px value, don't draw foreground
+    if (show_fore && filter_px)
+    {
+        bool fore_px_under_filter_px = true;
+        for (int i = 0; i < FORE_CH; ++i)
+            fore_px_under_filter_px = fore_px_under_filter_px && (fore_px[i] <= filter_px->val[i]);
+        show_fore = !fore_px_under_filter_px;
+    }
+    return show_fore;
+}
+
+// Blend foreground on top of image_roi in place, one specialization per
+// (background, foreground) channel combination, so channel loops are unrolled
+// and there is no per-pixel branching on channel number.
+// 
+// Parameters:
+//   - image_roi: pixels of background, it has max(BACK_CH, FORE_CH) channels
+//   - foreground: foreground image with FORE_CH channels, same size as image_roi
+//   - fore_weight: fixed-point foreground weight, 0 ~ (1 << STACK_IMGS_WEIGHT_BITS)
+//   - filter_px: same as mr::stack_imgs()
+// 
+// Note:
+//   - channels missing in background or foreground use default pixel (0,0,0,255),
+//     same as before, so output matches the floating point version within 1
+template<int BACK_CH, int FORE_CH>
+static void stack_imgs_blend_rows(
+    cv::Mat& image_roi,
+    const cv::Mat& foreground,
+    const int fore_weight,
+    const cv::Vec4b* filter_px
+)
+{
+    const int OUT_CH = (BACK_CH > FORE_CH) ? BACK_CH : FORE_CH;
+    const int back_weight = (1 << STACK_IMGS_WEIGHT_BITS) - fore_weight;
+    const int cols = image_roi.cols;
+    
+    cv::parallel_for_(cv::Range(0, image_roi.rows), [&](const cv::Range& range)
+    {
+        const uchar default_px[4] = {0, 0, 0, 255};
+
+#if CV_SIMD128
+        // same number of channels, blend the whole row as a flat byte array,
+        // with a byte mask marking channels of pixels to draw
+        std::vector<uchar> mask;
+        if (BACK_CH == FORE_CH)
+            mask.resize(static_cast<size_t>(cols) * OUT_CH);
+        const cv::v_uint16x8 v_fore_weight = cv::v_setall_u16(static_cast<ushort>(fore_weight));
+        const cv::v_uint16x8 v_back_weight = cv::v_setall_u16(static_cast<ushort>(back_weight));
+#endif
+        
+        for (int y = range.start; y < range.end; ++y)
+        {
+            uchar* out_row = image_roi.ptr<uchar>(y);
+            const uchar* fore_row = foreground.ptr<uchar>(y);
+
+#if CV_SIMD128
+            if (BACK_CH == FORE_CH)
+            {
+                for (int x = 0; x < cols; ++x)
+                {
+                    uchar m = stack_imgs_show_fore<FORE_CH>(fore_row + x * FORE_CH, filter_px) ? 255 : 0;
+                    for (int c = 0; c < OUT_CH; ++c)
+                        mask[x * OUT_CH + c] = m;
+                }
+                
+                const int len = cols * OUT_CH;
+                int i = 0;
+                for (; i <= len - cv::v_uint8x16::nlanes; i += cv::v_uint8x16::nlanes)
+                {
+                    cv::v_uint8x16 back = cv::v_load(out_row + i);
+                    cv::v_uint8x16 fore = cv::v_load(fore_row + i);
+                    cv::v_uint16x8 back_lo, back_hi, fore_lo, fore_hi;
+                    cv::v_expand(back, back_lo, back_hi);
+                    cv::v_expand(fore, fore_lo, fore_hi);
+                    // sum never exceeds 255 << STACK_IMGS_WEIGHT_BITS, so it fits in 16 bits
+                    back_lo = cv::v_shr<STACK_IMGS_WEIGHT_BITS>(cv::v_add_wrap(
+                        cv::v_mul_wrap(back_lo, v_back_weight), cv::v_mul_wrap(fore_lo, v_fore_weight)
+                    ));
+                    back_hi = cv::v_shr<STACK_IMGS_WEIGHT_BITS>(cv::v_add_wrap(
+                        cv::v_mul_wrap(back_hi, v_back_weight), cv::v_mul_wrap(fore_hi, v_fore_weight)
+                    ));
+                    cv::v_uint8x16 blended = cv::v_pack(back_lo, back_hi);
+                    cv::v_store(out_row + i, cv::v_select(cv::v_load(mask.data() + i), blended, back));
+                }
+                for (; i < len; ++i)
+                    if (mask[i])
+                        out_row[i] = static_cast<uchar>(
+                            (out_row[i] * back_weight + fore_row[i] * fore_weight) >> STACK_IMGS_WEIGHT_BITS
+                        );
+                continue;
+            }
+#endif
+            
+            for (int x = 0; x < cols; ++x)
+            {
+                const uchar* fore_px = fore_row + x * FORE_CH;
+                uchar* back_px = out_row + x * OUT_CH;
+                if (!stack_imgs_show_fore<FORE_CH>(fore_px, filter_px))
+                {
+                    // channels missing in background always take default pixel value
+                    for (int c = BACK_CH; c < OUT_CH; ++c)
+                        back_px[c] = default_px[c];
+                    continue;
+                }
+                for (int c = 0; c < OUT_CH; ++c)
+                {
+                    const int back_px_ch_val = (c < BACK_CH) ? back_px[c] : default_px[c];
+                    const int fore_px_ch_val = (c < FORE_CH) ? fore_px[c] : default_px[c];
+                    back_px[c] = static_cast<uchar>(
+                        (back_px_ch_val * back_weight + fore_px_ch_val * fore_weight) >> STACK_IMGS_WEIGHT_BITS
+                    );
+                }
+            }
+        }
+    });
+}
+
+// pick the stack_imgs_blend_rows() specialization once for the whole image
+static void stack_imgs_blend(
+    cv::Mat& image_roi,
+    const int background_channel,
+    const cv::Mat& foreground,
+    const float foreground_transparency,
+    const cv::Vec4b* filter_px
+)
+{
+    const int fore_weight = cvRound(
+        mr::clamp<float>(foreground_transparency, 0.0, 1.0) * (1 << STACK_IMGS_WEIGHT_BITS)
+    );
+    
+    // same as mr::sync_img_channel(), merge two channel numbers into one int
+    int choice = (background_channel << 4) | foreground.channels();
+    switch (choice)
+    {
+    case 0x11: stack_imgs_blend_rows<1, 1>(image_roi, foreground, fore_weight, filter_px); break;
+    case 0x13: stack_imgs_blend_rows<1, 3>(image_roi, foreground, fore_weight, filter_px); break;
+    case 0x14: stack_imgs_blend_rows<1, 4>(image_roi, foreground, fore_weight, filter_px); break;
+    case 0x31: stack_imgs_blend_rows<3, 1>(image_roi, foreground, fore_weight, filter_px); break;
+    case 0x33: stack_imgs_blend_rows<3, 3>(image_roi, foreground, fore_weight, filter_px); break;
+    case 0x34: stack_imgs_blend_rows<3, 4>(image_roi, foreground, fore_weight, filter_px); break;
+    case 0x41: stack_imgs_blend_rows<4, 1>(image_roi, foreground, fore_weight, filter_px); break;
+    case 0x43: stack_imgs_blend_rows<4, 3>(image_roi, foreground, fore_weight, filter_px); break;
+    case 0x44: stack_imgs_blend_rows<4, 4>(image_roi, foreground, fore_weight, filter_px); break;
+    default:
+        throw std::runtime_error("Invalid number of channels");
+        break;
+    }
+}
+
 EXPORT_SYMBOL void stack_imgs(
     const cv::Mat& background,
     const cv::Rect background_roi,
@@ -541,103 +901,17 @@ EXPORT_SYMBOL void stack_imgs(
     // copy a reference to image_out with updated roi so we can draw foreground on top of it
     cv::Mat background_with_roi = image_out(updated_background_roi);
     
-    // setup a function to select specific channel value from a foreground pixel,
-    // so we can use that to determine whether we should show foreground or not.
-    // we setup this function here so we don't need to add extra branching when
-    // we loop through all the pixels.
-    std::function<float(const uchar*)> select_fore_px_val;
-    
-    // 4 channel foreground, checking alpha 
-    if (foreground_channel == 4)
-    {
-        select_fore_px_val = [](const uchar* fore_px){
-            return static_cast<float>(fore_px[3]) / 255.0f;
-        };
-    }
-    // 3 channel foreground, checking if fore_px(b,g,r) == (0,0,0)
-    else if (foreground_channel == 3)
-    {
-        select_fore_px_val = [](const uchar* fore_px){
-            return (
-                (static_cast<float>(fore_px[0]) / 255.0f) + 
-                (static_cast<float>(fore_px[1]) / 255.0f) + 
-                (static_cast<float>(fore_px[2]) / 255.0f) 
-            );
-        };
-    }
-    // 1 channel foreground, checking if fore_px(b) == 0
-    else if (foreground_channel == 1)
-    {
-        select_fore_px_val = [](const uchar* fore_px){
-            return static_cast<float>(fore_px[0]) / 255.0f;
-        };
-    }
+    // alpha channel added by syncing 3 channels background is 255, same as default pixel,
+    // so blend it as a 4 channels background, which takes the vectorized path
+    int blend_background_channel = background_channel;
+    if (background_channel == 3 && max_channel == 4)
+        blend_background_channel = 4;
     
     // fill-in pixel values
-    float transparency_factor = mr::clamp<float>(foreground_transparency, 0.0, 1.0);
-    background_with_roi.forEach<cv::Vec4b>(
-    [
-        &background_with_roi, background_channel,
-        &foreground_copy, foreground_channel,
-        max_channel, transparency_factor,
-        filter_px, &select_fore_px_val
-    ]
-    (cv::Vec4b&, const int* position)
-    {
-        // accessing image pixel using uchar* to the underlying cv::Mat,
-        // so we can handle images with unknown channel number easier
-        const uchar* fore_px = foreground_copy.ptr<uchar>(position);
-        uchar* back_px = background_with_roi.ptr<uchar>(position);
-        cv::Vec4b default_px(0, 0, 0, 255);
-        
-        
-        // use a binary float to enable/disable foreground pixel
-        float show_fore = 0.0f;
-        // select foreground pixel value to compute show_fore
-        show_fore = mr::make_binary_num<float>(select_fore_px_val(fore_px), 0.0f, 0.0f, 1.0f);
-        
-        // when fore_px value <= filter_px value, don't draw foreground
-        if (filter_px)
-        {
-            uchar fore_px_under_filter_px = 1;
-            for (int i = 0; i < foreground_channel; ++i)
-                fore_px_under_filter_px = fore_px_under_filter_px & uchar(fore_px[i] <= filter_px->val[i]);
-            if (fore_px_under_filter_px)
-                show_fore = 0.0;
-        }
-        
-        
-        // if show_fore is 1.0, adding foreground pixel on top of background pixel,
-        // otherwise nothing will be add on top of background pixel.
-        for (int channel_idx = 0; channel_idx < max_channel; ++channel_idx)
-        {
-            // since we are accessing pixels via uchar* to the underlying cv::Mat,
-            // we don't want to mess up adjacent pixels. so we need to constantly
-            // check number of channels in background & foreground with current channel_idx.
-            // if current channel_idx excess number of channel in background or foreground,
-            // we use default_px(0,0,0,255) for the channel value
-            uchar back_px_ch_val = back_px[channel_idx];
-            if (channel_idx >= background_channel)
-                back_px_ch_val = default_px[channel_idx];
-            uchar fore_px_ch_val = fore_px[channel_idx];
-            if (channel_idx >= foreground_channel)
-                fore_px_ch_val = default_px[channel_idx];
-            
-            // when applying foreground transparency, we use transparency factor (0~1 float) multiply
-            // with the pixel, decrease its value, and then add it on top of background pixel,
-            // so two pixels' color will blend together.
-            // in this case, we also need to adjust background pixel's transparency.
-            // it will use (1 - transparency_factor) as its transparency factor.
-            back_px[channel_idx] = static_cast<uchar>(
-                (
-                    back_px_ch_val * (1.0 - (transparency_factor * show_fore))
-                ) +
-                (
-                    fore_px_ch_val * transparency_factor * show_fore
-                )
-            );
-        }
-    });
+    mr::stack_imgs_blend(
+        background_with_roi, blend_background_channel,
+        foreground_copy, foreground_transparency, filter_px
+    );
 }
 
 EXPORT_SYMBOL void stack_imgs_in_place(
@@ -697,103 +971,11 @@ EXPORT_SYMBOL void stack_imgs_in_place(
     // copy a reference to background with updated roi so we can draw foreground on top of it
     cv::Mat background_with_roi = background(updated_background_roi);
     
-    // setup a function to select specific channel value from a foreground pixel,
-    // so we can use that to determine whether we should show foreground or not.
-    // we setup this function here so we don't need to add extra branching when
-    // we loop through all the pixels.
-    std::function<float(const uchar*)> select_fore_px_val;
-    
-    // 4 channel foreground, checking alpha 
-    if (foreground_channel == 4)
-    {
-        select_fore_px_val = [](const uchar* fore_px){
-            return static_cast<float>(fore_px[3]) / 255.0f;
-        };
-    }
-    // 3 channel foreground, checking if fore_px(b,g,r) == (0,0,0)
-    else if (foreground_channel == 3)
-    {
-        select_fore_px_val = [](const uchar* fore_px){
-            return (
-                (static_cast<float>(fore_px[0]) / 255.0f) + 
-                (static_cast<float>(fore_px[1]) / 255.0f) + 
-                (static_cast<float>(fore_px[2]) / 255.0f) 
-            );
-        };
-    }
-    // 1 channel foreground, checking if fore_px(b) == 0
-    else if (foreground_channel == 1)
-    {
-        select_fore_px_val = [](const uchar* fore_px){
-            return static_cast<float>(fore_px[0]) / 255.0f;
-        };
-    }
-    
     // fill-in pixel values
-    float transparency_factor = mr::clamp<float>(foreground_transparency, 0.0, 1.0);
-    background_with_roi.forEach<cv::Vec4b>(
-    [
-        &background_with_roi, background_channel,
-        &foreground_copy, foreground_channel,
-        transparency_factor,
-        filter_px, &select_fore_px_val
-    ]
-    (cv::Vec4b&, const int* position)
-    {
-        // accessing image pixel using uchar* to the underlying cv::Mat,
-        // so we can handle images with unknown channel number easier
-        const uchar* fore_px = foreground_copy.ptr<uchar>(position);
-        uchar* back_px = background_with_roi.ptr<uchar>(position);
-        cv::Vec4b default_px(0, 0, 0, 255);
-        
-        
-        // use a binary float to enable/disable foreground pixel
-        float show_fore = 0.0f;
-        // select foreground pixel value to compute show_fore
-        show_fore = mr::make_binary_num<float>(select_fore_px_val(fore_px), 0.0f, 0.0f, 1.0f);
-        
-        // when fore_px value <= filter_px value, don't draw foreground
-        if (filter_px)
-        {
-            uchar fore_px_under_filter_px = 1;
-            for (int i = 0; i < foreground_channel; ++i)
-                fore_px_under_filter_px = fore_px_under_filter_px & uchar(fore_px[i] <= filter_px->val[i]);
-            if (fore_px_under_filter_px)
-                show_fore = 0.0;
-        }
-        
-        
-        // if show_fore is 1.0, adding foreground pixel on top of background pixel,
-        // otherwise nothing will be add on top of background pixel.
-        for (int channel_idx = 0; channel_idx < background_channel; ++channel_idx)
-        {
-            // since we are accessing pixels via uchar* to the underlying cv::Mat,
-            // we don't want to mess up adjacent pixels. so we need to constantly
-            // check number of channels in background & foreground with current channel_idx.
-            // if current channel_idx excess number of channel in background or foreground,
-            // we use default_px(0,0,0,255) for the channel value
-            uchar back_px_ch_val = back_px[channel_idx];
-            if (channel_idx >= background_channel)
-                back_px_ch_val = default_px[channel_idx];
-            uchar fore_px_ch_val = fore_px[channel_idx];
-            if (channel_idx >= foreground_channel)
-                fore_px_ch_val = default_px[channel_idx];
-            
-            // when applying foreground transparency, we use transparency factor (0~1 float) multiply
-            // with the pixel, decrease its value, and then add it on top of background pixel,
-            // so two pixels' color will blend together.
-            // in this case, we also need to adjust background pixel's transparency.
-            // it will use (1 - transparency_factor) as its transparency factor.
-            back_px[channel_idx] = static_cast<uchar>(
-                (
-                    back_px_ch_val * (1.0 - (transparency_factor * show_fore))
-                ) +
-                (
-                    fore_px_ch_val * transparency_factor * show_fore
-                )
-            );
-        }
-    });
+    mr::stack_imgs_blend(
+        background_with_roi, background_channel,
+        foreground_copy, foreground_transparency, filter_px
+    );
 }
 
 }
@@ -42,4 +42,38 @@ EXPORT_SYMBOL double norm_kp(
     return mr::norm_ptf(kp1.pt, kp2.pt, method);
 }
 
+EXPORT_SYMBOL cv::Matx33d calc_scale_matrix(
+    const cv::Size& src_size,
+    const cv::Size& dst_size
+)
+{
+    // map pixel centers onto pixel centers, same as cv::resize()
+    double scale_x = static_cast<double>(dst_size.width) / static_cast<double>(src_size.width);
+    double scale_y = static_cast<double>(dst_size.height) / static_cast<double>(src_size.height);
+    return cv::Matx33d(
+        scale_x, 0.0, 0.5 * scale_x - 0.5,
+        0.0, scale_y, 0.5 * scale_y - 0.5,
+        0.0, 0.0, 1.0
+    );
+}
+
+EXPORT_SYMBOL void rescale_keypoints(
+    std::vector<cv::KeyPoint>& keypoints,
+    const cv::Matx33d& scale_matrix
+)
+{
+    float scale_x = static_cast<float>(scale_matrix(0, 0));
+    float scale_y = static_cast<float>(scale_matrix(1, 1));
+    float offset_x = static_cast<float>(scale_matrix(0, 2));
+    float offset_y = static_cast<float>(scale_matrix(1, 2));
+    // keypoint size is a diameter, use mean scale of both axis
+    float scale_size = (scale_x + scale_y) / 2.0f;
+    for (auto& kpt : keypoints)
+    {
+        kpt.pt.x = kpt.pt.x * scale_x + offset_x;
+        kpt.pt.y = kpt.pt.y * scale_y + offset_y;
+        kpt.size *= scale_size;
+    }
+}
+
 }